@@ -0,0 +1,330 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <fstream>
+#include <map>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+#include "vad_iterator.h"
+#include "wav.h"
+#include "frontend.h"
+
+// Throughput benchmark for VadIterator. Every combination of window size,
+// intra-op thread count and input (synthetic recordings of the requested
+// lengths plus any WAV files given) is run `repeat` times after a warm-up,
+// and one JSON object per combination is printed to stdout:
+//
+//   {"source":"synthetic","audio_s":60.0,"window_ms":32,"threads":1,...}
+//
+// rtf is median wall time / audio time, chunks_per_s uses the same median,
+// p50_us/p99_us are per-window latencies of commit_window() pooled over
+// all repeats, and peak_rss_kb is the process peak so far.
+//
+// With --baseline=FILE (an earlier output), configurations whose
+// chunks_per_s dropped by more than --tolerance percent are reported on
+// stderr and the exit code is 3, so the benchmark can gate the hot path.
+
+struct BenchInput {
+    std::string source;
+    std::vector<float> samples;  // 16 kHz mono
+};
+
+struct BenchResult {
+    size_t chunks = 0;
+    double wall_s = 0.0;
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+};
+
+// Deterministic speech-like test signal: voiced bursts (a harmonic stack
+// with a syllable-rate envelope) separated by pauses of low noise.
+static std::vector<float> synthesize(double seconds, unsigned seed) {
+    const int sample_rate = 16000;
+    const double pi = 3.14159265358979323846;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> burst_len(1.0, 3.0);
+    std::uniform_real_distribution<double> pause_len(0.5, 4.0);
+    std::uniform_real_distribution<double> pitch(100.0, 220.0);
+    std::normal_distribution<float> noise(0.0f, 0.002f);
+
+    std::vector<float> out(static_cast<size_t>(seconds * sample_rate));
+    size_t i = 0;
+    bool voiced = false;
+    while (i < out.size()) {
+        size_t len = static_cast<size_t>((voiced ? burst_len(rng) : pause_len(rng)) * sample_rate);
+        double f0 = pitch(rng);
+        for (size_t k = 0; k < len && i < out.size(); k++, i++) {
+            float v = noise(rng);
+            if (voiced) {
+                double t = static_cast<double>(k) / sample_rate;
+                double env = 0.5 - 0.5 * std::cos(2.0 * pi * 4.0 * t);
+                double s = 0.0;
+                for (int h = 1; h <= 8; h++)
+                    s += std::sin(2.0 * pi * f0 * h * t) / h;
+                v += static_cast<float>(0.2 * env * s);
+            }
+            out[i] = v;
+        }
+        voiced = !voiced;
+    }
+    return out;
+}
+
+static bool load_corpus_file(const std::string& path, BenchInput& input) {
+    wav::WavMmapReader reader;
+    if (!reader.Open(path) || reader.num_samples() == 0) {
+        std::cerr << "Error: cannot read WAV file: " << path << "\n";
+        return false;
+    }
+    std::vector<float> interleaved(reader.num_data());
+    reader.Convert(0, interleaved.size(), interleaved.data());
+    frontend::AudioFrontend front(reader.sample_rate(), reader.num_channel());
+    size_t n;
+    const float* mono = front.process(interleaved.data(), reader.num_samples(), &n);
+    input.source = path;
+    input.samples.assign(mono, mono + n);
+    return true;
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty())
+        return 0.0;
+    size_t k = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+// Peak resident set size of the process in KiB (0 where unsupported).
+static long peak_rss_kb() {
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static BenchResult run_one(const std::string& model_path, const std::vector<float>& audio,
+                           int window_ms, int threads, int repeat) {
+    EngineConfig engine;
+    engine.intra_threads = threads;
+    VadIterator vad(model_path, 16000, window_ms, 0.5f, 100, 30, 250,
+                    std::numeric_limits<float>::infinity(), engine);
+    const size_t window = vad.window_size();
+    const size_t num_windows = audio.size() / window;
+
+    // Warm-up: the first runs pay for ORT's lazy initialisation.
+    std::vector<float> warm(audio.begin(), audio.begin() + std::min(audio.size(), static_cast<size_t>(16000)));
+    vad.process(warm);
+
+    BenchResult result;
+    std::vector<double> walls, latencies;
+    latencies.reserve(num_windows * repeat);
+    for (int r = 0; r < repeat; r++) {
+        vad.reset();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t w = 0; w < num_windows; w++) {
+            std::copy(audio.begin() + w * window, audio.begin() + (w + 1) * window, vad.window_input());
+            auto t0 = std::chrono::steady_clock::now();
+            vad.commit_window();
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+        }
+        vad.feed(audio.data() + num_windows * window, audio.size() - num_windows * window);
+        vad.finish();
+        walls.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    result.chunks = num_windows;
+    result.wall_s = percentile(walls, 0.5);
+    result.p50_us = percentile(latencies, 0.50);
+    result.p99_us = percentile(latencies, 0.99);
+    return result;
+}
+
+// Parses a comma separated list of positive integers.
+static std::vector<int> parse_list(const std::string& s) {
+    std::vector<int> out;
+    std::stringstream in(s);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        int v = std::atoi(item.c_str());
+        if (v > 0)
+            out.push_back(v);
+    }
+    return out;
+}
+
+static std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// Identity of a configuration: the line up to its first measured field.
+static std::string config_key(const std::string& line) {
+    return line.substr(0, line.find(",\"repeat\""));
+}
+
+// Value of a numeric field of one output line, or -1 if absent.
+static double json_number(const std::string& line, const std::string& key) {
+    size_t at = line.find("\"" + key + "\":");
+    if (at == std::string::npos)
+        return -1.0;
+    return std::atof(line.c_str() + at + key.size() + 3);
+}
+
+static bool load_baseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Error: cannot open baseline: " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        double v = json_number(line, "chunks_per_s");
+        if (v > 0)
+            baseline[config_key(line)] = v;
+    }
+    return true;
+}
+
+static void usage() {
+    std::cerr << "Usage: ./vad_bench [options] [corpus.wav ...]\n"
+              << "  --model=PATH        ONNX model (default: " << MODEL_PATH << ")\n"
+              << "  --int8              benchmark the model's INT8 variant (<name>.int8.onnx)\n"
+              << "  --window-ms=LIST    window sizes in ms (default: 32)\n"
+              << "  --threads=LIST      intra-op thread counts (default: 1,2,4)\n"
+              << "  --lengths=LIST      synthetic recording lengths in s (default: 10,60,600)\n"
+              << "  --repeat=N          timed runs per configuration (default: 3)\n"
+              << "  --seed=N            synthetic audio seed (default: 1)\n"
+              << "  --baseline=FILE     compare chunks_per_s against an earlier run\n"
+              << "  --tolerance=PCT     allowed slowdown against the baseline (default: 10)\n";
+}
+
+int main(int argc, char** argv) {
+    std::string model_path = MODEL_PATH;
+    std::vector<int> windows_ms = { 32 };
+    std::vector<int> thread_counts = { 1, 2, 4 };
+    std::vector<int> lengths = { 10, 60, 600 };
+    int repeat = 3;
+    unsigned seed = 1;
+    std::vector<std::string> corpus;
+    std::map<std::string, double> baseline;
+    double tolerance = 10.0;
+    bool int8 = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-h" || a == "--help") {
+            usage();
+            return 0;
+        } else if (a.rfind("--model=", 0) == 0) {
+            model_path = a.substr(8);
+        } else if (a == "--int8") {
+            int8 = true;
+        } else if (a.rfind("--window-ms=", 0) == 0) {
+            windows_ms = parse_list(a.substr(12));
+        } else if (a.rfind("--threads=", 0) == 0) {
+            thread_counts = parse_list(a.substr(10));
+        } else if (a.rfind("--lengths=", 0) == 0) {
+            lengths = parse_list(a.substr(10));
+        } else if (a.rfind("--repeat=", 0) == 0) {
+            repeat = std::max(1, std::atoi(a.c_str() + 9));
+        } else if (a.rfind("--seed=", 0) == 0) {
+            seed = static_cast<unsigned>(std::atoi(a.c_str() + 7));
+        } else if (a.rfind("--baseline=", 0) == 0) {
+            if (!load_baseline(a.substr(11), baseline))
+                return 1;
+        } else if (a.rfind("--tolerance=", 0) == 0) {
+            tolerance = std::max(0.0, std::atof(a.c_str() + 12));
+        } else if (a.rfind("--", 0) == 0) {
+            std::cerr << "Unknown arg: " << a << "\n";
+            usage();
+            return 1;
+        } else {
+            corpus.push_back(a);
+        }
+    }
+
+    if (int8)
+        model_path = int8_model_path(model_path);
+
+    std::vector<BenchInput> inputs;
+    for (int len : lengths)
+        inputs.push_back({ "synthetic", synthesize(len, seed) });
+    for (const std::string& path : corpus) {
+        BenchInput input;
+        if (!load_corpus_file(path, input))
+            return 1;
+        inputs.push_back(std::move(input));
+    }
+
+    const unsigned cpus = std::thread::hardware_concurrency();
+    int failures = 0;
+    int regressions = 0;
+    for (const BenchInput& input : inputs) {
+        const double audio_s = input.samples.size() / 16000.0;
+        for (int window_ms : windows_ms) {
+            for (int threads : thread_counts) {
+                std::ostringstream line;
+                line << std::fixed << "{\"source\":\"" << json_escape(input.source) << "\""
+                     << ",\"audio_s\":" << std::setprecision(2) << audio_s
+                     << ",\"window_ms\":" << window_ms
+                     << ",\"threads\":" << threads
+                     << ",\"repeat\":" << repeat
+                     << ",\"cpus\":" << cpus;
+                try {
+                    BenchResult r = run_one(model_path, input.samples, window_ms, threads, repeat);
+                    line << ",\"chunks\":" << r.chunks
+                         << ",\"wall_s\":" << std::setprecision(6) << r.wall_s
+                         << ",\"rtf\":" << (audio_s > 0 ? r.wall_s / audio_s : 0.0)
+                         << ",\"chunks_per_s\":" << std::setprecision(1) << (r.wall_s > 0 ? r.chunks / r.wall_s : 0.0)
+                         << ",\"p50_us\":" << r.p50_us
+                         << ",\"p99_us\":" << r.p99_us;
+                } catch (const std::exception& e) {
+                    line << ",\"error\":\"" << json_escape(e.what()) << "\"";
+                    failures++;
+                }
+                line << ",\"peak_rss_kb\":" << peak_rss_kb() << "}";
+                std::cout << line.str() << std::endl;
+
+                auto base = baseline.find(config_key(line.str()));
+                double now = json_number(line.str(), "chunks_per_s");
+                if (base != baseline.end() && now > 0 && now < base->second * (1.0 - tolerance / 100.0)) {
+                    std::cerr << "REGRESSION " << config_key(line.str()) << "}: "
+                              << std::fixed << std::setprecision(1) << now << " chunks/s vs "
+                              << base->second << " baseline\n";
+                    regressions++;
+                }
+            }
+        }
+    }
+    if (failures != 0)
+        return 1;
+    return regressions == 0 ? 0 : 3;
+}
@@ -0,0 +1,217 @@
+#ifndef CHUNKING_H_
+#define CHUNKING_H_
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "vad_iterator.h" // timestamp_t
+
+// Post-processing of speech segments into transcription chunks, as the
+// merging_utils programs did it over text files (1-create_tag, 2-create_merge,
+// 3-min_cut), but as streaming operators over timestamp_t. Each stage takes
+// segments and the tagged gaps between them through push_segment() and
+// push_gap(), and hands its output to the next stage as soon as it is
+// final, so the chain runs in one pass and can follow a live stream:
+//
+//   ChunkCollector out;
+//   MinCut cut(options, out);
+//   GapMerger merge(cut);
+//   GapTagger tag(options, merge);
+//   for (const timestamp_t& t : stamps) tag.push_segment(t);
+//   tag.finish();                                     // out.chunks is complete
+//
+// All positions are in samples.
+namespace chunking {
+
+// Gap classes of 1-create_tag.
+enum class GapTag {
+    merge,      // shorter than micro_pause: the segments are joined
+    candidate,  // a place to cut a chunk that grows past max_seg
+    brk         // longer than long_break: always cut
+};
+
+// Thresholds in seconds, defaults as in merging_utils.
+struct ChunkOptions {
+    double micro_pause = 0.15;
+    double long_break = 5.0;
+    double max_seg = 30.0;   // 0 = no limit
+    int sample_rate = 16000;
+
+    int samples(double seconds) const {
+        return static_cast<int>(std::lround(seconds * sample_rate));
+    }
+};
+
+// A stage's input. push_gap() always comes between the two segments it
+// separates.
+class SegmentSink {
+public:
+    virtual ~SegmentSink() = default;
+    virtual void push_segment(const timestamp_t& segment) = 0;
+    virtual void push_gap(int64_t gap, GapTag tag) { (void)gap; (void)tag; }
+    virtual void finish() {}
+};
+
+// 1-create_tag: classifies the gap before every segment but the first.
+class GapTagger : public SegmentSink {
+private:
+    SegmentSink& next;
+    int micro_pause;
+    int long_break;
+    int64_t prev_end = 0;
+    bool have_prev = false;
+
+public:
+    GapTagger(const ChunkOptions& options, SegmentSink& Next)
+        : next(Next),
+          micro_pause(options.samples(options.micro_pause)),
+          long_break(options.samples(options.long_break)) { }
+
+    void push_segment(const timestamp_t& segment) override {
+        if (have_prev) {
+            const int64_t gap = segment.start - prev_end;
+            next.push_gap(gap, gap < micro_pause ? GapTag::merge
+                             : gap > long_break ? GapTag::brk
+                             : GapTag::candidate);
+        }
+        next.push_segment(segment);
+        prev_end = segment.end;
+        have_prev = true;
+    }
+
+    void finish() override {
+        next.finish();
+        have_prev = false;
+        prev_end = 0;
+    }
+};
+
+// 2-create_merge: joins segments across merge gaps; other gaps are passed
+// on after the segment before them.
+class GapMerger : public SegmentSink {
+private:
+    SegmentSink& next;
+    timestamp_t current;
+    bool have_current = false;
+    bool merge_next = false;
+
+public:
+    explicit GapMerger(SegmentSink& Next) : next(Next) { }
+
+    void push_gap(int64_t gap, GapTag tag) override {
+        if (tag == GapTag::merge) {
+            merge_next = true;
+            return;
+        }
+        if (have_current) {
+            next.push_segment(current);
+            have_current = false;
+        }
+        next.push_gap(gap, tag);
+    }
+
+    void push_segment(const timestamp_t& segment) override {
+        if (have_current && merge_next) {
+            current.end = segment.end;
+            merge_next = false;
+            return;
+        }
+        if (have_current)
+            next.push_segment(current);
+        current = segment;
+        have_current = true;
+    }
+
+    void finish() override {
+        if (have_current)
+            next.push_segment(current);
+        have_current = merge_next = false;
+        next.finish();
+    }
+};
+
+// 3-min_cut: grows a chunk over candidate gaps; once it reaches max_seg it
+// is cut at the end of the segment before the widest candidate gap seen
+// since the last cut, and the rest starts the next chunk. Break gaps always
+// end the chunk.
+class MinCut : public SegmentSink {
+private:
+    SegmentSink& next;
+    int max_seg;
+    int64_t chunk_start = 0;
+    int64_t chunk_end = 0;
+    int64_t best_gap = 0;
+    int64_t best_gap_pos = 0;
+    bool have_chunk = false;
+
+    void emit(int64_t start, int64_t end) {
+        timestamp_t chunk(start, end);
+        next.push_segment(chunk);
+    }
+
+public:
+    MinCut(const ChunkOptions& options, SegmentSink& Next)
+        : next(Next),
+          max_seg(options.max_seg > 0.0 ? options.samples(options.max_seg) : std::numeric_limits<int>::max()) { }
+
+    void push_gap(int64_t gap, GapTag tag) override {
+        if (tag == GapTag::candidate) {
+            if (gap > best_gap) {
+                best_gap = gap;
+                best_gap_pos = chunk_end;
+            }
+        } else if (tag == GapTag::brk) {
+            if (have_chunk)
+                emit(chunk_start, chunk_end);
+            have_chunk = false;
+            best_gap = best_gap_pos = 0;
+        }
+    }
+
+    void push_segment(const timestamp_t& segment) override {
+        if (!have_chunk) {
+            chunk_start = segment.start;
+            have_chunk = true;
+        }
+        chunk_end = segment.end;
+        if (chunk_end - chunk_start >= max_seg && best_gap_pos > chunk_start) {
+            emit(chunk_start, best_gap_pos);
+            chunk_start = best_gap_pos;
+            best_gap = best_gap_pos = 0;
+        }
+    }
+
+    void finish() override {
+        if (have_chunk)
+            emit(chunk_start, chunk_end);
+        have_chunk = false;
+        best_gap = best_gap_pos = 0;
+        next.finish();
+    }
+};
+
+// End of a chain: keeps what reaches it.
+class ChunkCollector : public SegmentSink {
+public:
+    std::vector<timestamp_t> chunks;
+
+    void push_segment(const timestamp_t& segment) override { chunks.push_back(segment); }
+};
+
+// Runs the whole chain over the segments of one recording.
+inline std::vector<timestamp_t> make_chunks(const std::vector<timestamp_t>& stamps, const ChunkOptions& options) {
+    ChunkCollector out;
+    MinCut cut(options, out);
+    GapMerger merge(cut);
+    GapTagger tag(options, merge);
+    for (const timestamp_t& t : stamps)
+        tag.push_segment(t);
+    tag.finish();
+    return out.chunks;
+}
+
+} // namespace chunking
+
+#endif  // CHUNKING_H_
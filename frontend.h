@@ -0,0 +1,206 @@
+#ifndef FRONTEND_H_
+#define FRONTEND_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Audio front-end for the VAD: turns interleaved audio of any channel count
+// and sample rate into a mono stream at the rate the Silero model runs at,
+// 16 kHz by default or 8 kHz.
+namespace frontend {
+
+// Dot product of two float arrays; the vector path is picked at compile
+// time from the target flags, like the PCM kernels in wav.h.
+static inline float dot_product(const float* a, const float* b, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+#if defined(__FMA__)
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+#else
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+#endif
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    sum = _mm_cvtss_f32(half);
+#elif defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#endif
+    for (; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// Averages interleaved channels into mono.
+static inline void downmix(const float* in, int channels, size_t frames, float* out) {
+    if (channels == 1) {
+        std::copy(in, in + frames, out);
+        return;
+    }
+    const float scale = 1.0f / channels;
+    if (channels == 2) {
+        for (size_t i = 0; i < frames; i++)
+            out[i] = (in[2 * i] + in[2 * i + 1]) * scale;
+        return;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++)
+            sum += in[i * channels + c];
+        out[i] = sum * scale;
+    }
+}
+
+// PolyphaseResampler: streaming rational resampler (upsample by L, low-pass,
+// decimate by M) from a Kaiser-windowed sinc prototype. Each output sample
+// is one dot product of a filter phase with the most recent input samples,
+// so only the outputs that are kept get computed. 48 kHz -> 16 kHz is
+// L/M = 1/3, 44.1 kHz -> 16 kHz is 160/441.
+class PolyphaseResampler {
+private:
+    int up;                 // L
+    int down;               // M
+    int taps;               // taps per phase
+    std::vector<float> phases;  // [L][taps], each phase reversed for dot_product
+    std::vector<float> history; // taps - 1 past samples followed by new input
+    size_t pos = 0;             // index in history of the next output's newest input
+    int phase = 0;              // filter phase of the next output
+
+    static double bessel_i0(double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 50; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+            if (term < 1e-12 * sum)
+                break;
+        }
+        return sum;
+    }
+
+public:
+    PolyphaseResampler(int in_rate, int out_rate, int taps_per_phase = 32, double kaiser_beta = 8.0)
+        : taps(taps_per_phase)
+    {
+        int g = std::gcd(in_rate, out_rate);
+        up = out_rate / g;
+        down = in_rate / g;
+
+        // Prototype low-pass at the upsampled rate, cut off a little below
+        // the lower of the two Nyquist frequencies.
+        const int length = taps * up;
+        const double cutoff = 0.5 / std::max(up, down) * 0.92;
+        const double center = (length - 1) / 2.0;
+        const double pi = 3.14159265358979323846;
+        std::vector<double> proto(length);
+        for (int n = 0; n < length; n++) {
+            double t = n - center;
+            double sinc = (t == 0.0) ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+            double r = 2.0 * n / (length - 1) - 1.0;
+            double window = bessel_i0(kaiser_beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(kaiser_beta);
+            proto[n] = up * sinc * window;
+        }
+
+        // Phase p holds proto[p + k*L] for k = 0..taps-1, stored reversed so
+        // it lines up with input samples in time order.
+        phases.resize(static_cast<size_t>(up) * taps);
+        for (int p = 0; p < up; p++)
+            for (int k = 0; k < taps; k++)
+                phases[static_cast<size_t>(p) * taps + (taps - 1 - k)] = static_cast<float>(proto[p + k * up]);
+        reset();
+    }
+
+    void reset() {
+        history.assign(taps - 1, 0.0f);
+        pos = taps - 1;
+        phase = 0;
+    }
+
+    // Resamples the next n input samples, appending the outputs to out.
+    void process(const float* in, size_t n, std::vector<float>& out) {
+        history.insert(history.end(), in, in + n);
+        while (pos < history.size()) {
+            const float* x = history.data() + pos - (taps - 1);
+            out.push_back(dot_product(phases.data() + static_cast<size_t>(phase) * taps, x, taps));
+            phase += down;
+            pos += phase / up;
+            phase %= up;
+        }
+        // Keep only the taps - 1 samples the next output still needs.
+        size_t keep_from = std::min(pos, history.size()) - (taps - 1);
+        history.erase(history.begin(), history.begin() + keep_from);
+        pos -= keep_from;
+    }
+};
+
+// AudioFrontend: downmixes interleaved blocks to mono and resamples them to
+// out_rate, block by block. When the input already matches, process()
+// hands the block back untouched.
+class AudioFrontend {
+private:
+    int in_rate;
+    int channels;
+    int out_rate;
+    std::vector<float> mono;
+    std::vector<float> output;
+    std::unique_ptr<PolyphaseResampler> resampler;
+
+public:
+    AudioFrontend(int InRate, int Channels, int OutRate = 16000)
+        : in_rate(InRate), channels(Channels), out_rate(OutRate)
+    {
+        if (in_rate != out_rate)
+            resampler = std::make_unique<PolyphaseResampler>(in_rate, out_rate);
+    }
+
+    bool passthrough() const { return channels == 1 && in_rate == out_rate; }
+
+    // Converts frames interleaved frames; the result is valid until the
+    // next call. *out_samples receives the number of output samples.
+    const float* process(const float* interleaved, size_t frames, size_t* out_samples) {
+        if (passthrough()) {
+            *out_samples = frames;
+            return interleaved;
+        }
+        const float* src = interleaved;
+        if (channels != 1) {
+            mono.resize(frames);
+            downmix(interleaved, channels, frames, mono.data());
+            src = mono.data();
+        }
+        if (!resampler) {
+            *out_samples = frames;
+            return src;
+        }
+        output.clear();
+        resampler->process(src, frames, output);
+        *out_samples = output.size();
+        return output.data();
+    }
+};
+
+}  // namespace frontend
+
+#endif  // FRONTEND_H_
@@ -0,0 +1,399 @@
+#ifndef ORT_SETUP_H_
+#define ORT_SETUP_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "onnxruntime_cxx_api.h"
+
+// Session setup shared by every Silero session: the process-wide Ort::Env,
+// the threading settings (EngineConfig), a start-up auto-tuner that times
+// candidate settings on this host and caches the winner per machine,
+// ONNX Runtime version and model hash, and a cache of the optimized graph
+// so later processes skip parsing and optimizing the ONNX model.
+
+// Process-wide ONNX Runtime environment. ORT expects a single Ort::Env per
+// process, so every iterator creates its session from this one.
+inline Ort::Env& vad_env() {
+    static Ort::Env env;
+    return env;
+}
+
+// Threading settings of one session.
+struct EngineConfig {
+    int intra_threads = 1;
+    int inter_threads = 1;
+    bool parallel = false;   // ORT_PARALLEL execution mode
+    bool spinning = true;    // intra-op workers busy-wait between runs
+
+    // "intra=4 inter=1 mode=seq spin=1", as stored in the cache.
+    std::string str() const {
+        std::ostringstream out;
+        out << "intra=" << intra_threads << " inter=" << inter_threads
+            << " mode=" << (parallel ? "par" : "seq") << " spin=" << (spinning ? 1 : 0);
+        return out.str();
+    }
+
+    static bool parse(const std::string& s, EngineConfig& cfg) {
+        char mode[8] = {};
+        int spin = 1;
+        if (std::sscanf(s.c_str(), "intra=%d inter=%d mode=%7s spin=%d",
+                        &cfg.intra_threads, &cfg.inter_threads, mode, &spin) != 4)
+            return false;
+        cfg.parallel = std::string(mode) == "par";
+        cfg.spinning = spin != 0;
+        return cfg.intra_threads > 0 && cfg.inter_threads > 0;
+    }
+};
+
+// Applies the session settings shared by every Silero session.
+inline void apply_engine_config(Ort::SessionOptions& session_options, const EngineConfig& cfg) {
+    session_options.SetIntraOpNumThreads(cfg.intra_threads);
+    session_options.SetInterOpNumThreads(cfg.inter_threads);
+    session_options.SetExecutionMode(cfg.parallel ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+    session_options.AddConfigEntry("session.intra_op.allow_spinning", cfg.spinning ? "1" : "0");
+    session_options.AddConfigEntry("session.inter_op.allow_spinning", cfg.spinning ? "1" : "0");
+    session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+}
+
+// FNV-1a hash of the model file, as 16 hex digits ("" if unreadable).
+inline std::string model_hash(const std::string& model_path) {
+    std::ifstream in(model_path, std::ios::binary);
+    if (!in)
+        return "";
+    uint64_t h = 1469598103934665603ull;
+    char buf[1 << 16];
+    while (in) {
+        in.read(buf, sizeof(buf));
+        for (std::streamsize i = 0; i < in.gcount(); i++) {
+            h ^= static_cast<unsigned char>(buf[i]);
+            h *= 1099511628211ull;
+        }
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+    return hex;
+}
+
+// Identifies the host for the cache: hostname, CPU model and core count.
+inline std::string machine_id() {
+    std::string host = "unknown";
+#if defined(_WIN32)
+    if (const char* name = std::getenv("COMPUTERNAME"))
+        host = name;
+#else
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) == 0)
+        host = name;
+#endif
+    std::string cpu;
+#if defined(__linux__)
+    std::ifstream info("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(info, line)) {
+        if (line.rfind("model name", 0) == 0) {
+            cpu = line.substr(line.find(':') + 1);
+            cpu.erase(0, cpu.find_first_not_of(' '));
+            break;
+        }
+    }
+#endif
+    std::string id = host + "/" + cpu + "/" + std::to_string(std::thread::hardware_concurrency());
+    std::replace(id.begin(), id.end(), '\t', ' ');
+    return id;
+}
+
+// Cache location: $SILERO_VAD_ENGINE_CACHE, else the user cache directory.
+inline std::string engine_cache_path() {
+    if (const char* p = std::getenv("SILERO_VAD_ENGINE_CACHE"))
+        return p;
+#if defined(_WIN32)
+    const char* base = std::getenv("LOCALAPPDATA");
+    return base ? std::string(base) + "\\silero-vad\\engine.cache" : "silero-vad-engine.cache";
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"))
+        return std::string(xdg) + "/silero-vad/engine.cache";
+    const char* home = std::getenv("HOME");
+    return home ? std::string(home) + "/.cache/silero-vad/engine.cache" : "silero-vad-engine.cache";
+#endif
+}
+
+// Name to write path under before renaming it into place. It is unique per
+// process and thread, so concurrent writers never share a temporary file.
+inline std::string temp_path_for(const std::string& path) {
+#if defined(_WIN32)
+    const long pid = static_cast<long>(_getpid());
+#else
+    const long pid = static_cast<long>(getpid());
+#endif
+    return path + "." + std::to_string(pid) + "." +
+           std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+}
+
+// Cache key: machine, ORT version, model hash, sample rate, batch size and
+// the thread budget the winner was picked for, tab separated.
+inline std::string engine_cache_key(const std::string& model_path, int sample_rate, int batch, int max_threads) {
+    return machine_id() + "\t" + Ort::GetVersionString() + "\t" + model_hash(model_path) + "\t" +
+           std::to_string(sample_rate) + "\t" + std::to_string(batch) + "\t" + std::to_string(max_threads);
+}
+
+inline bool load_engine_config(const std::string& key, EngineConfig& cfg) {
+    std::ifstream in(engine_cache_path());
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.size() > key.size() && line.compare(0, key.size(), key) == 0 && line[key.size()] == '\t')
+            return EngineConfig::parse(line.substr(key.size() + 1), cfg);
+    }
+    return false;
+}
+
+inline void store_engine_config(const std::string& key, const EngineConfig& cfg) {
+    const std::string path = engine_cache_path();
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!(line.size() > key.size() && line.compare(0, key.size(), key) == 0 && line[key.size()] == '\t'))
+                lines.push_back(line);
+        }
+    }
+    lines.push_back(key + "\t" + cfg.str());
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    const std::string tmp = temp_path_for(path);
+    {
+        std::ofstream out(tmp);
+        for (const std::string& l : lines)
+            out << l << "\n";
+        if (!out) {
+            std::cerr << "Warning: cannot write engine cache " << path << "\n";
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
+
+// ----- Optimized model cache -----
+// The first session for a model saves the graph ORT produced after its
+// optimization passes, in ORT format, next to the engine cache; later
+// sessions load that file with optimization off. The name carries the
+// model hash, ORT version and machine, since ORT_ENABLE_ALL output can be
+// specific to the CPU it was made on. SILERO_VAD_MODEL_CACHE=0 disables it.
+
+inline std::string fnv1a_hex(const std::string& s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+    return hex;
+}
+
+inline bool model_cache_enabled() {
+    const char* v = std::getenv("SILERO_VAD_MODEL_CACHE");
+    return !(v && std::string(v) == "0");
+}
+
+// Cached optimized copy of model_path ("" if the model is unreadable).
+inline std::string optimized_model_path(const std::string& model_path) {
+    const std::string hash = model_hash(model_path);
+    if (hash.empty())
+        return "";
+    std::filesystem::path dir = std::filesystem::path(engine_cache_path()).parent_path();
+    std::string stem = std::filesystem::path(model_path).stem().string();
+    return (dir / (stem + "." + hash + "." + fnv1a_hex(Ort::GetVersionString() + machine_id()) + ".ort")).string();
+}
+
+#if defined(_WIN32)
+inline std::wstring ort_path(const std::string& p) { return std::filesystem::path(p).wstring(); }
+#else
+inline std::string ort_path(const std::string& p) { return p; }
+#endif
+
+// Creates a session for model_path with engine's threading, through the
+// optimized model cache.
+inline std::shared_ptr<Ort::Session> create_vad_session(const std::string& model_path,
+                                                        const EngineConfig& engine,
+                                                        Ort::SessionOptions& session_options) {
+    apply_engine_config(session_options, engine);
+    const std::string cached = model_cache_enabled() ? optimized_model_path(model_path) : "";
+    if (cached.empty())
+        return std::make_shared<Ort::Session>(vad_env(), ort_path(model_path).c_str(), session_options);
+
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(cached, ec)) {
+        Ort::SessionOptions options = session_options.Clone();
+        options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+        options.AddConfigEntry("session.load_model_format", "ORT");
+        try {
+            auto session = std::make_shared<Ort::Session>(vad_env(), ort_path(cached).c_str(), options);
+            session_options = std::move(options);
+            return session;
+        } catch (const Ort::Exception& e) {
+            std::cerr << "Warning: ignoring unusable optimized model " << cached << ": " << e.what() << "\n";
+            std::filesystem::remove(cached, ec);
+        }
+    }
+
+    // Save the optimized graph under a temporary name and publish it with
+    // a rename, so concurrent first runs never load a partial file.
+    std::filesystem::create_directories(std::filesystem::path(cached).parent_path(), ec);
+    const std::string tmp = temp_path_for(cached);
+    Ort::SessionOptions options = session_options.Clone();
+    options.SetOptimizedModelFilePath(ort_path(tmp).c_str());
+    options.AddConfigEntry("session.save_model_format", "ORT");
+    auto session = std::make_shared<Ort::Session>(vad_env(), ort_path(model_path).c_str(), options);
+    std::filesystem::rename(tmp, cached, ec);
+    if (ec)
+        std::filesystem::remove(tmp, ec);
+    return session;
+}
+
+// INT8 variant of a model, as written by tools/quantize_model.py next to
+// it: silero_vad.onnx -> silero_vad.int8.onnx.
+inline std::string int8_model_path(const std::string& model_path) {
+    std::filesystem::path path(model_path);
+    return (path.parent_path() / (path.stem().string() + ".int8" + path.extension().string())).string();
+}
+
+// The Silero model runs at 16 kHz or 8 kHz. Each window is preceded by
+// the last samples of the one before: 64 at 16 kHz, 32 at 8 kHz. Throws
+// std::invalid_argument for any other rate.
+inline int context_samples_for(int sample_rate) {
+    if (sample_rate == 16000)
+        return 64;
+    if (sample_rate == 8000)
+        return 32;
+    throw std::invalid_argument("Silero VAD runs at 16000 or 8000 Hz, not " + std::to_string(sample_rate));
+}
+
+// Mean microseconds per 32 ms window (512 samples at 16 kHz, 256 at 8 kHz)
+// of the Silero model under cfg, run for batch streams at once as
+// VadBatchIterator does.
+inline double time_engine_config(const std::string& model_path, const EngineConfig& cfg, int sample_rate = 16000,
+                                 int batch = 1, int warmup_windows = 30, int timed_windows = 200) {
+    const int64_t window = sample_rate / 1000 * 32 + context_samples_for(sample_rate);
+    Ort::SessionOptions options;
+    std::shared_ptr<Ort::Session> session = create_vad_session(model_path, cfg, options);
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+
+    std::vector<float> input(batch * window), state_in(2 * batch * 128, 0.0f), state_out(2 * batch * 128), prob(batch);
+    std::vector<int64_t> sr = { sample_rate };
+    const int64_t input_dims[2] = { batch, window };
+    const int64_t state_dims[3] = { 2, batch, 128 };
+    const int64_t sr_dims[1] = { 1 };
+    const int64_t prob_dims[2] = { batch, 1 };
+    uint32_t seed = 1;
+    for (float& x : input) {
+        seed = seed * 1664525u + 1013904223u;
+        x = (static_cast<int>(seed >> 16) - 32768) / 327680.0f;
+    }
+
+    Ort::Value inputs[3] = {
+        Ort::Value::CreateTensor<float>(memory_info, input.data(), input.size(), input_dims, 2),
+        Ort::Value::CreateTensor<float>(memory_info, state_in.data(), state_in.size(), state_dims, 3),
+        Ort::Value::CreateTensor<int64_t>(memory_info, sr.data(), sr.size(), sr_dims, 1),
+    };
+    Ort::Value outputs[2] = {
+        Ort::Value::CreateTensor<float>(memory_info, prob.data(), prob.size(), prob_dims, 2),
+        Ort::Value::CreateTensor<float>(memory_info, state_out.data(), state_out.size(), state_dims, 3),
+    };
+    const char* input_names[3] = { "input", "state", "sr" };
+    const char* output_names[2] = { "output", "stateN" };
+    Ort::RunOptions run_options{ nullptr };
+
+    auto run = [&]() {
+        session->Run(run_options, input_names, inputs, 3, output_names, outputs, 2);
+    };
+    for (int i = 0; i < warmup_windows; i++)
+        run();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < timed_windows; i++)
+        run();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / timed_windows;
+}
+
+// Times the candidate settings with at most max_threads threads per
+// session and returns the fastest at sample_rate and batch size: intra-op
+// threads in powers of two, each with spinning on and off, sequential and
+// parallel execution.
+inline EngineConfig tune_engine_config(const std::string& model_path, int max_threads, int sample_rate = 16000,
+                                       int batch = 1, bool verbose = false) {
+    std::vector<EngineConfig> candidates;
+    for (int intra = 1; intra <= max_threads; intra *= 2) {
+        for (int mode = 0; mode < 2; mode++) {
+            for (int spin = 1; spin >= 0; spin--) {
+                if (intra == 1 && spin == 0)
+                    continue;  // no intra-op pool to spin
+                EngineConfig cfg;
+                cfg.intra_threads = intra;
+                cfg.parallel = mode == 1;
+                cfg.inter_threads = cfg.parallel ? std::min(2, max_threads) : 1;
+                cfg.spinning = spin == 1;
+                candidates.push_back(cfg);
+            }
+        }
+    }
+
+    EngineConfig best;
+    double best_us = -1.0;
+    for (const EngineConfig& cfg : candidates) {
+        double us = time_engine_config(model_path, cfg, sample_rate, batch);
+        if (verbose)
+            std::cerr << "  " << cfg.str() << ": " << us << " us/window\n";
+        // Candidates run simplest first; a later one has to be clearly
+        // faster to win, so timing noise does not pick exotic settings.
+        if (best_us < 0 || us < best_us * 0.97) {
+            best = cfg;
+            best_us = us;
+        }
+    }
+    return best;
+}
+
+// Cached tuning: returns the stored winner for this machine, ORT version,
+// model, sample rate, batch size and thread budget, tuning (and storing)
+// it first if there is none or retune is set. max_threads <= 0 means all
+// cores; batch is the number of streams per inference call.
+inline EngineConfig auto_engine_config(const std::string& model_path, int max_threads = 0, bool retune = false,
+                                       int sample_rate = 16000, int batch = 1) {
+    if (max_threads <= 0)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    const std::string key = engine_cache_key(model_path, sample_rate, batch, max_threads);
+    EngineConfig cfg;
+    if (!retune && load_engine_config(key, cfg))
+        return cfg;
+
+    std::cerr << "Tuning ONNX Runtime threading for this machine (up to " << max_threads << " threads)...\n";
+    cfg = tune_engine_config(model_path, max_threads, sample_rate, batch, true);
+    std::cerr << "Using " << cfg.str() << ", cached in " << engine_cache_path() << "\n";
+    store_engine_config(key, cfg);
+    return cfg;
+}
+
+#endif  // ORT_SETUP_H_
@@ -0,0 +1,149 @@
+#ifndef CAPTURE_RING_H_
+#define CAPTURE_RING_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+// CaptureRing: fixed-size history of the captured audio, so a speech
+// segment can be handed out with the pre-roll from before the VAD fired.
+// The ring always keeps the last capacity() samples; start_segment() marks
+// a segment pre_roll samples before its detected start, and end_segment()
+// hands [start, end) to the sink as a Span pointing into the ring, without
+// copying. A segment that would outgrow the ring is handed out in pieces
+// of at most capacity() samples as it goes, so memory stays fixed however
+// long the speech lasts. Positions are absolute sample counts since
+// construction. Single-threaded: push, segment calls and the sink all run
+// on the inference thread.
+template <typename T>
+class CaptureRing {
+public:
+    // Samples [start, end) as at most two contiguous runs of the ring.
+    struct Span {
+        const T* data[2];
+        size_t size[2];
+        uint64_t start;
+        uint64_t end;
+
+        size_t length() const { return size[0] + size[1]; }
+    };
+
+    // Receives each piece of a segment; final is set on its last piece. The
+    // span is only valid during the call.
+    using Sink = std::function<void(const Span&, bool final)>;
+
+private:
+    std::vector<T> buf;
+    size_t mask;
+    size_t pre_roll;
+    Sink sink;
+
+    uint64_t pos = 0;             // samples pushed (or skipped) so far
+    uint64_t seg_start = 0;       // first sample not yet handed out
+    bool active = false;
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    Span span(uint64_t start, uint64_t end) const {
+        Span s;
+        const size_t at = static_cast<size_t>(start) & mask;
+        const size_t n = static_cast<size_t>(end - start);
+        s.size[0] = std::min(n, buf.size() - at);
+        s.size[1] = n - s.size[0];
+        s.data[0] = buf.data() + at;
+        s.data[1] = buf.data();
+        s.start = start;
+        s.end = end;
+        return s;
+    }
+
+    // Hands out what the segment holds so far, before the ring reuses it.
+    void flush_piece() {
+        if (pos > seg_start && sink)
+            sink(span(seg_start, pos), false);
+        seg_start = pos;
+    }
+
+    void write(const T* data, size_t n) {
+        const size_t at = static_cast<size_t>(pos) & mask;
+        const size_t first = std::min(n, buf.size() - at);
+        if (data) {
+            std::memcpy(buf.data() + at, data, first * sizeof(T));
+            std::memcpy(buf.data(), data + first, (n - first) * sizeof(T));
+        } else {
+            std::fill(buf.begin() + at, buf.begin() + at + first, T());
+            std::fill(buf.begin(), buf.begin() + (n - first), T());
+        }
+        pos += n;
+    }
+
+    void append(const T* data, size_t n) {
+        while (n > 0) {
+            const size_t take = std::min(n, buf.size());
+            if (active && pos + take - seg_start > buf.size())
+                flush_piece();
+            write(data, take);
+            if (data)
+                data += take;
+            n -= take;
+        }
+    }
+
+public:
+    // capacity is rounded up to a power of two and must exceed pre_roll.
+    CaptureRing(size_t capacity, size_t Pre_roll, Sink Sink_fn = Sink())
+        : buf(round_up_pow2(std::max(capacity, Pre_roll + 1))), mask(buf.size() - 1),
+          pre_roll(Pre_roll), sink(std::move(Sink_fn)) { }
+
+    CaptureRing(const CaptureRing&) = delete;
+    CaptureRing& operator=(const CaptureRing&) = delete;
+
+    void set_sink(Sink Sink_fn) { sink = std::move(Sink_fn); }
+
+    size_t capacity() const { return buf.size(); }
+    size_t pre_roll_samples() const { return pre_roll; }
+    uint64_t position() const { return pos; }
+    bool in_segment() const { return active; }
+
+    // Appends captured samples.
+    void push(const T* data, size_t n) { append(data, n); }
+
+    // Advances over n samples that were lost (ring overruns) as silence,
+    // so positions stay aligned with the device clock.
+    void skip(size_t n) { append(nullptr, n); }
+
+    // Opens a segment detected at sample at (<= position()); it starts
+    // pre_roll samples earlier, or at the oldest sample still held.
+    void start_segment(uint64_t at) {
+        if (active)
+            return;
+        const uint64_t oldest = pos > buf.size() ? pos - buf.size() : 0;
+        const uint64_t wanted = at > pre_roll ? at - pre_roll : 0;
+        seg_start = std::min(pos, std::max(oldest, wanted));
+        active = true;
+    }
+
+    // Closes the open segment at sample at (<= position()) and hands out
+    // its last piece.
+    void end_segment(uint64_t at) {
+        if (!active)
+            return;
+        const uint64_t end = std::max(seg_start, std::min(at, pos));
+        if (sink)
+            sink(span(seg_start, end), true);
+        active = false;
+    }
+
+    // Drops the open segment without handing out the rest.
+    void cancel_segment() { active = false; }
+};
+
+#endif  // CAPTURE_RING_H_
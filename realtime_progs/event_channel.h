@@ -0,0 +1,382 @@
+#ifndef EVENT_CHANNEL_H_
+#define EVENT_CHANNEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+  #include <cerrno>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+// Local publish/subscribe channel for VAD events. The publisher listens on
+// a Unix domain socket and sends every event, as one fixed-size binary
+// record, to each connected subscriber; any number of processes can
+// subscribe, and each gets the event as soon as it is published.
+//
+// publish() never waits for a subscriber: the send is non-blocking, and a
+// subscriber whose socket buffer is full misses that event instead of
+// delaying the publisher or the others. It can tell from a gap in seq.
+// A subscriber that hangs up is dropped. On Linux the socket is
+// SOCK_SEQPACKET, so records arrive whole; elsewhere it is SOCK_STREAM,
+// and a subscriber that falls behind in the middle of a record is
+// disconnected.
+
+// One event, in host byte order (the channel is local).
+struct VadEvent {
+    enum Type : uint16_t {
+        start   = 1,        // speech started at sample
+        end     = 2,        // speech ended at sample, length samples long
+        reset   = 3,        // VAD state reset at sample; ends an open segment
+        overrun = 4,        // length samples dropped before sample
+    };
+
+    uint32_t magic;         // kVadEventMagic
+    uint16_t version;       // kVadEventVersion
+    uint16_t type;          // Type
+    uint64_t seq;           // per publisher, from 1; a gap means missed events
+    uint64_t sample;        // position on the source's clock, in samples
+    uint64_t length;        // see Type, else 0
+    int64_t wall_us;        // wall clock (Unix epoch) at sample
+    int64_t sent_us;        // wall clock when published
+    uint32_t sample_rate;
+    float probability;      // of the chunk that caused it, else 0
+    char source[32];        // source name, NUL-terminated
+};
+
+static const uint32_t kVadEventMagic = 0x45444156;   // "VADE"
+static const uint16_t kVadEventVersion = 1;
+static_assert(sizeof(VadEvent) == 88, "VadEvent is a wire format");
+
+inline const char* event_type_name(uint16_t type) {
+    switch (type) {
+    case VadEvent::start:   return "START";
+    case VadEvent::end:     return "END";
+    case VadEvent::reset:   return "RESET";
+    case VadEvent::overrun: return "OVERRUN";
+    default:                return "UNKNOWN";
+    }
+}
+
+inline int64_t wall_clock_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// $XDG_RUNTIME_DIR/rt_vad.sock, or /tmp/rt_vad-<uid>.sock without one.
+inline std::string default_event_path() {
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime)
+        return std::string(runtime) + "/rt_vad.sock";
+#if defined(_WIN32)
+    return "rt_vad.sock";
+#else
+    return "/tmp/rt_vad-" + std::to_string(getuid()) + ".sock";
+#endif
+}
+
+#if !defined(_WIN32)
+
+namespace event_channel_detail {
+
+#if defined(__linux__)
+static const int kSocketType = SOCK_SEQPACKET;
+#else
+static const int kSocketType = SOCK_STREAM;
+#endif
+
+#if defined(MSG_NOSIGNAL)
+static const int kSendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+static const int kSendFlags = MSG_DONTWAIT;   // SO_NOSIGPIPE is set instead
+#endif
+
+inline void no_sigpipe(int fd) {
+#if defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)fd;
+#endif
+}
+
+// Fills addr; false if path does not fit.
+inline bool make_address(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+}  // namespace event_channel_detail
+
+class EventPublisher {
+private:
+    std::string path;
+    int listen_fd = -1;
+    int wake_pipe[2] = { -1, -1 };  // wakes the acceptor on stop()
+    std::thread acceptor;
+
+    std::mutex mutex;               // guards subscribers and next_seq
+    std::vector<int> subscribers;
+    uint64_t next_seq = 1;
+
+    std::atomic<uint64_t> published_events{0};
+    std::atomic<uint64_t> missed_events{0};      // summed over subscribers
+    std::atomic<uint64_t> connections{0};
+
+    void remove_locked(int fd) {
+        for (size_t i = 0; i < subscribers.size(); i++) {
+            if (subscribers[i] == fd) {
+                close(fd);
+                subscribers.erase(subscribers.begin() + i);
+                return;
+            }
+        }
+    }
+
+    // Accepts subscribers and notices those that hang up between events.
+    void run() {
+        std::vector<pollfd> fds;
+        char scratch[256];
+        while (true) {
+            fds.clear();
+            fds.push_back({ wake_pipe[0], POLLIN, 0 });
+            fds.push_back({ listen_fd, POLLIN, 0 });
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (int fd : subscribers)
+                    fds.push_back({ fd, POLLIN, 0 });
+            }
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            if (fds[0].revents)
+                return;
+            if (fds[1].revents & POLLIN) {
+                int fd = accept(listen_fd, NULL, NULL);
+                if (fd >= 0) {
+                    event_channel_detail::no_sigpipe(fd);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    subscribers.push_back(fd);
+                    connections++;
+                }
+            }
+            // Subscribers only read; anything else on their socket is
+            // discarded, and end of file means they are gone. publish() may
+            // have dropped one meanwhile, but only this thread adds
+            // descriptors, so a number still in the list is the one polled.
+            for (size_t i = 2; i < fds.size(); i++) {
+                if (!fds[i].revents)
+                    continue;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (std::find(subscribers.begin(), subscribers.end(), fds[i].fd) == subscribers.end())
+                    continue;
+                ssize_t n = recv(fds[i].fd, scratch, sizeof(scratch), MSG_DONTWAIT);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                    remove_locked(fds[i].fd);
+            }
+        }
+    }
+
+public:
+    explicit EventPublisher(const std::string& Path) : path(Path) { }
+    ~EventPublisher() { stop(); }
+
+    EventPublisher(const EventPublisher&) = delete;
+    EventPublisher& operator=(const EventPublisher&) = delete;
+
+    // Creates the socket and starts accepting subscribers. A socket file
+    // left by a publisher that died is replaced; one that still answers
+    // is not.
+    bool start() {
+        sockaddr_un addr;
+        if (!event_channel_detail::make_address(path, addr)) {
+            std::fprintf(stderr, "events: socket path too long: %s\n", path.c_str());
+            return false;
+        }
+        int probe = socket(AF_UNIX, event_channel_detail::kSocketType, 0);
+        if (probe >= 0) {
+            const bool live = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+            close(probe);
+            if (live) {
+                std::fprintf(stderr, "events: %s is in use by another publisher\n", path.c_str());
+                return false;
+            }
+        }
+        unlink(path.c_str());
+
+        listen_fd = socket(AF_UNIX, event_channel_detail::kSocketType, 0);
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            chmod(path.c_str(), 0600) != 0 || listen(listen_fd, 16) != 0 || pipe(wake_pipe) != 0) {
+            std::fprintf(stderr, "events: cannot listen on %s: %s\n", path.c_str(), std::strerror(errno));
+            stop();
+            return false;
+        }
+        fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+        acceptor = std::thread(&EventPublisher::run, this);
+        return true;
+    }
+
+    // Disconnects every subscriber and removes the socket file.
+    void stop() {
+        if (acceptor.joinable()) {
+            char c = 0;
+            if (write(wake_pipe[1], &c, 1) == 1)
+                acceptor.join();
+            else
+                acceptor.detach();
+        }
+        // The socket goes first, so nobody connects to a closing publisher.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            listen_fd = -1;
+            unlink(path.c_str());
+        }
+        for (int fd : subscribers)
+            close(fd);
+        subscribers.clear();
+        for (int& fd : wake_pipe) {
+            if (fd >= 0)
+                close(fd);
+            fd = -1;
+        }
+    }
+
+    // Sends e to every subscriber; fills in magic, version, seq and
+    // sent_us. Never blocks on a subscriber.
+    void publish(VadEvent e) {
+        e.magic = kVadEventMagic;
+        e.version = kVadEventVersion;
+        e.source[sizeof(e.source) - 1] = '\0';
+        std::lock_guard<std::mutex> lock(mutex);
+        e.seq = next_seq++;
+        e.sent_us = wall_clock_us();
+        for (size_t i = 0; i < subscribers.size();) {
+            ssize_t n = send(subscribers[i], &e, sizeof(e), event_channel_detail::kSendFlags);
+            if (n == static_cast<ssize_t>(sizeof(e))) {
+                i++;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                missed_events++;
+                i++;
+            } else {
+                // Gone, or a partial record on a stream socket.
+                remove_locked(subscribers[i]);
+            }
+        }
+        published_events++;
+    }
+
+    const std::string& socket_path() const { return path; }
+    size_t subscriber_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return subscribers.size();
+    }
+    uint64_t published() const { return published_events.load(std::memory_order_relaxed); }
+    uint64_t missed() const { return missed_events.load(std::memory_order_relaxed); }
+    uint64_t connected() const { return connections.load(std::memory_order_relaxed); }
+};
+
+class EventSubscriber {
+private:
+    int fd = -1;
+
+public:
+    EventSubscriber() = default;
+    ~EventSubscriber() { disconnect(); }
+
+    EventSubscriber(const EventSubscriber&) = delete;
+    EventSubscriber& operator=(const EventSubscriber&) = delete;
+
+    // Connects to a publisher; false if none is listening at path.
+    bool connect(const std::string& path) {
+        disconnect();
+        sockaddr_un addr;
+        if (!event_channel_detail::make_address(path, addr))
+            return false;
+        fd = socket(AF_UNIX, event_channel_detail::kSocketType, 0);
+        if (fd < 0)
+            return false;
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    void disconnect() {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+
+    bool connected() const { return fd >= 0; }
+
+    // Waits up to timeout_ms (-1: no limit) for the next event. Returns 1
+    // with an event in e, 0 on timeout, and -1 once the publisher is gone.
+    // Records of another format or version are skipped.
+    int next(VadEvent& e, int timeout_ms = -1) {
+        while (fd >= 0) {
+            pollfd p = { fd, POLLIN, 0 };
+            int r = poll(&p, 1, timeout_ms);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r == 0)
+                return 0;
+            ssize_t n = r < 0 ? -1 : recv(fd, &e, sizeof(e), MSG_WAITALL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n != static_cast<ssize_t>(sizeof(e))) {
+                disconnect();
+                return -1;
+            }
+            if (e.magic == kVadEventMagic && e.version == kVadEventVersion)
+                return 1;
+        }
+        return -1;
+    }
+};
+
+#else  // _WIN32: no Unix domain sockets here; the channel is unavailable.
+
+class EventPublisher {
+    std::string path;
+
+public:
+    explicit EventPublisher(const std::string& Path) : path(Path) { }
+    bool start() {
+        std::fprintf(stderr, "events: not supported on this platform\n");
+        return false;
+    }
+    void stop() { }
+    void publish(VadEvent) { }
+    const std::string& socket_path() const { return path; }
+    size_t subscriber_count() { return 0; }
+    uint64_t published() const { return 0; }
+    uint64_t missed() const { return 0; }
+    uint64_t connected() const { return 0; }
+};
+
+#endif
+
+#endif  // EVENT_CHANNEL_H_
@@ -8,7 +8,31 @@
 //    Prints "(manual reset invoked)"
 //  - Idle auto-reset (--idle-reset=N seconds):
 //    If no speech for N seconds, resets VAD state and prints "(silence reset)"
-//  - Select desktop as source (--source=dt)
+//  - Select desktop as source (--source=dt), or several sources at once
+//    (--source=mic,dt): each gets its own device, clock and VAD state,
+//    all of them run through one batched ONNX Runtime call per chunk,
+//    and with more than one source every line is tagged "[source] "
+//  - The audio callback only pushes samples into a lock-free ring;
+//    inference and printing run on a separate VAD thread. Ring overruns
+//    are reported as "(overrun: N samples dropped)".
+//  - Timing stats (predict/callback durations, queue depth, drops and
+//    speech-onset latency) go to stderr on SIGUSR1, and to a file every
+//    few seconds with --stats-file=PATH [--stats-interval=SECONDS]
+//  - --tune / --retune: cached per-machine ONNX Runtime threading
+//  - --int8: run the INT8 model (silero_vad.int8.onnx) instead
+//  - --sample-rate=8000: capture at 8 kHz and run the model on 256-sample
+//    windows (default 16000, 512)
+//  - Speech audio is kept in a fixed-size capture ring (capture_ring.h)
+//    with --pre-roll-ms of audio from before each START (default 300);
+//    segments longer than --capture-s (default 30) are handed out in
+//    pieces, so memory stays bounded
+//  - --record[=DIR] saves speech to DIR (default ~/.transcription) from a
+//    writer thread (segment_recorder.h): one WAV per segment, or with
+//    --record-mode=stream one WAV per run with a cue per segment, plus
+//    DIR/index.tsv. Ctrl-C then finishes the files before exiting
+//  - --events[=PATH] publishes START/END/reset/overrun as binary records
+//    on a Unix domain socket (event_channel.h) for any number of local
+//    subscribers, e.g. vad_events
 // ====================================================================
 
 #define MINIAUDIO_IMPLEMENTATION
@@ -21,6 +45,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#include <cctype>
 #include <chrono>
 #include <sstream>
 #include <iomanip>
@@ -29,6 +54,14 @@
 #include <atomic>
 #include <fstream>
 #include <string>
+#include <csignal>
+#include <cstdlib>
+#include <algorithm>
+
+#include "spsc_ring.h"
+#include "capture_ring.h"
+#include "segment_recorder.h"
+#include "event_channel.h"
 
 #if defined(_WIN32)
   #include <io.h>
@@ -39,228 +72,67 @@
 #endif
 
 // ====================================================================
-//  ONNX Runtime + embedded VADIterator (no external headers needed)
+//  VadBatchIterator and ONNX Runtime session setup, shared with vad
 // ====================================================================
 
-#include "onnxruntime_cxx_api.h"
-
-class timestamp_t {
-public:
-    int start;
-    int end;
-    timestamp_t(int s=-1, int e=-1) : start(s), end(e) {}
-};
-
-class VadIterator {
-private:
-    Ort::Env env;
-    Ort::SessionOptions session_options;
-    std::shared_ptr<Ort::Session> session = nullptr;
-    Ort::AllocatorWithDefaultOptions allocator;
-    Ort::MemoryInfo memory_info =
-        Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
-
-    const int context_samples = 64;
-    std::vector<float> _context;
-
-    int window_size_samples;
-    int effective_window_size;
-    int sr_per_ms;
-
-    std::vector<Ort::Value> ort_inputs;
-    std::vector<const char*> input_node_names = {"input","state","sr"};
-    std::vector<float> input;
-
-    unsigned int size_state = 2*1*128;
-    std::vector<float> _state;
-
-    std::vector<int64_t> sr;
-    int64_t input_node_dims[2] = {};
-    const int64_t state_node_dims[3] = {2,1,128};
-    const int64_t sr_node_dims[1] = {1};
-
-    std::vector<Ort::Value> ort_outputs;
-    std::vector<const char*> output_node_names = {"output","stateN"};
-
-    int sample_rate;
-    float threshold;
-    int min_silence_samples;
-    int min_silence_samples_at_max_speech;
-    int min_speech_samples;
-    float max_speech_samples;
-    int speech_pad_samples;
-
-    bool triggered = false;
-    unsigned int temp_end = 0;
-    unsigned int current_sample = 0;
-    int prev_end = 0;
-    int next_start = 0;
-    std::vector<timestamp_t> speeches;
-    timestamp_t current_speech;
-
-    void init_engine_threads(int inter, int intra)
-    {
-        session_options.SetIntraOpNumThreads(intra);
-        session_options.SetInterOpNumThreads(inter);
-        session_options.SetGraphOptimizationLevel(
-            GraphOptimizationLevel::ORT_ENABLE_ALL
-        );
-    }
-
-    void init_onnx_model(const std::string &path)
-    {
-        init_engine_threads(1,1);
-        session =
-            std::make_shared<Ort::Session>(env, path.c_str(), session_options);
-    }
-
-    void reset_states()
-    {
-        std::memset(_state.data(), 0, _state.size()*sizeof(float));
-        triggered=false;
-        temp_end=0;
-        current_sample=0;
-        prev_end=0;
-        next_start=0;
-        speeches.clear();
-        current_speech = timestamp_t();
-        std::fill(_context.begin(), _context.end(), 0.f);
-    }
-
-public:
-    VadIterator(const std::string& ModelPath,
-                int Sample_rate = 16000,
-                int windows_frame = 32,
-                float Threshold = 0.5,
-                int min_silence_ms = 100,
-                int pad_ms = 30,
-                int min_speech_ms = 250,
-                float max_speech_s = INFINITY)
-        : sample_rate(Sample_rate),
-          threshold(Threshold),
-          speech_pad_samples(pad_ms)
-    {
-        sr_per_ms = sample_rate / 1000;
-
-        window_size_samples = windows_frame * sr_per_ms;
-        effective_window_size = window_size_samples + context_samples;
-
-        input_node_dims[0] = 1;
-        input_node_dims[1] = effective_window_size;
-
-        _state.resize(size_state);
-        sr.resize(1);
-        sr[0] = sample_rate;
-
-        _context.assign(context_samples, 0.f);
-
-        min_speech_samples = sr_per_ms * min_speech_ms;
-        max_speech_samples =
-            (sample_rate * max_speech_s -
-             window_size_samples -
-             2 * speech_pad_samples);
+#include "../vad_iterator.h"   // VadBatchIterator, EngineConfig, auto_engine_config()
 
-        min_silence_samples = sr_per_ms * min_silence_ms;
-        min_silence_samples_at_max_speech = sr_per_ms * 98;
 
-        init_onnx_model(ModelPath);
+// ====================================================================
+//  INSTRUMENTATION
+// ====================================================================
+// Log2 histogram. Each histogram has a single writer thread and record()
+// is a handful of relaxed atomic stores, so the audio thread can use it;
+// any thread may read it for a report.
+struct Histogram {
+    static const int kBuckets = 32;   // bucket k holds values in [2^(k-1), 2^k)
+    std::atomic<uint64_t> counts[kBuckets] = {};
+    std::atomic<uint64_t> n{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+    void record(uint64_t v) {
+        int k = 0;
+        while (k < kBuckets - 1 && (uint64_t(1) << k) <= v)
+            k++;
+        counts[k].store(counts[k].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        if (v > max.load(std::memory_order_relaxed))
+            max.store(v, std::memory_order_relaxed);
     }
 
-    void predict(const std::vector<float> &data_chunk)
-    {
-        // shifted context buffer + chunk
-        std::vector<float> new_data(effective_window_size, 0.f);
-        std::copy(_context.begin(), _context.end(), new_data.begin());
-        std::copy(data_chunk.begin(),
-                  data_chunk.end(),
-                  new_data.begin() + context_samples);
-
-        input = new_data;
-
-        Ort::Value input_ort =
-            Ort::Value::CreateTensor<float>(memory_info,
-                                            input.data(),
-                                            input.size(),
-                                            input_node_dims, 2);
-
-        Ort::Value state_ort =
-            Ort::Value::CreateTensor<float>(memory_info,
-                                            _state.data(),
-                                            _state.size(),
-                                            state_node_dims, 3);
-
-        Ort::Value sr_ort =
-            Ort::Value::CreateTensor<int64_t>(memory_info,
-                                              sr.data(),
-                                              sr.size(),
-                                              sr_node_dims, 1);
-
-        ort_inputs.clear();
-        ort_inputs.emplace_back(std::move(input_ort));
-        ort_inputs.emplace_back(std::move(state_ort));
-        ort_inputs.emplace_back(std::move(sr_ort));
-
-        ort_outputs =
-            session->Run(Ort::RunOptions{nullptr},
-                         input_node_names.data(),
-                         ort_inputs.data(),
-                         ort_inputs.size(),
-                         output_node_names.data(),
-                         output_node_names.size());
-
-        float speech_prob =
-            ort_outputs[0].GetTensorMutableData<float>()[0];
-
-        float *stateN =
-            ort_outputs[1].GetTensorMutableData<float>();
-        std::memcpy(_state.data(), stateN, size_state*sizeof(float));
-
-        current_sample += window_size_samples;
-
-        // START
-        if (speech_prob >= threshold) {
-            if (!triggered) {
-                triggered = true;
-                current_speech.start =
-                    current_sample - window_size_samples;
-            }
-            std::copy(new_data.end() - context_samples,
-                      new_data.end(),
-                      _context.begin());
-            return;
+    // Upper bound of the bucket holding the p-quantile.
+    uint64_t quantile(double p) const {
+        uint64_t total = n.load(std::memory_order_relaxed), seen = 0;
+        for (int k = 0; k < kBuckets; k++) {
+            seen += counts[k].load(std::memory_order_relaxed);
+            if (total > 0 && seen >= p * total)
+                return uint64_t(1) << k;
         }
-
-        // END
-        if (triggered && speech_prob < (threshold - 0.15)) {
-            temp_end = (temp_end == 0) ? current_sample : temp_end;
-
-            if ((current_sample - temp_end) >= min_silence_samples) {
-                current_speech.end = temp_end;
-
-                if (current_speech.end -
-                    current_speech.start > min_speech_samples)
-                {
-                    speeches.push_back(current_speech);
-                }
-                triggered = false;
-                temp_end  = 0;
-                current_speech = timestamp_t();
-            }
-        }
-
-        std::copy(new_data.end() - context_samples,
-                  new_data.end(),
-                  _context.begin());
+        return max.load(std::memory_order_relaxed);
     }
 
-    bool is_triggered() const { return triggered; }
-    int  get_current_start() const { return current_speech.start; }
-
-    const std::vector<timestamp_t> get_speech_timestamps() const {
-        return speeches;
+    std::string summary(const char* name, const char* unit) const {
+        uint64_t count = n.load(std::memory_order_relaxed);
+        std::ostringstream out;
+        out << std::left << std::setw(14) << name << " n=" << count;
+        if (count > 0) {
+            out << " mean=" << sum.load(std::memory_order_relaxed) / count << unit
+                << " p50<" << quantile(0.50) << unit
+                << " p90<" << quantile(0.90) << unit
+                << " p99<" << quantile(0.99) << unit
+                << " max=" << max.load(std::memory_order_relaxed) << unit;
+        }
+        return out.str();
     }
+};
 
-    void reset() { reset_states(); }
+// Capture time of the audio pushed by one callback: samples up to end
+// (counted in ring samples) arrived at time_us.
+struct CaptureMark {
+    uint64_t end;
+    int64_t time_us;
 };
 
 
@@ -268,17 +140,61 @@ public:
 //  GLOBALS / STATE
 // ====================================================================
 
-static std::unique_ptr<VadIterator> g_vad;
-static std::mutex g_mutex;
+// Model rate (--sample-rate=8000 or 16000) and its 32 ms window.
+static int g_sample_rate = 16000;
+static int g_chunk_size  = 512;
 
-static const int SAMPLE_RATE = 16000;
-static const int CHUNK_SIZE  = 512;
+// One capture device and everything that follows its audio. The device's
+// callback is the only writer of ring, marks, pushed and callback_us; the
+// rest belongs to the VAD thread, under g_mutex where the main thread
+// also reaches it (resets, shutdown).
+struct Source {
+    std::string name;                  // --source entry; tags its output
+    int stream = 0;                    // its stream in g_vad
 
-static std::atomic<bool> g_in_speech{false};
-static std::vector<float> ring_buffer;
+    ma_device_id device_id = {};
+    bool use_device_id = false;        // false: the default capture device
+    ma_device device;
 
-static std::atomic<uint64_t> g_total_samples{0};      // global time; never reset
-static std::atomic<uint64_t> g_last_speech_samples{0}; // last time speech was seen
+    // Audio thread -> VAD thread; 2 s of slack before the callback drops audio.
+    SpscRing<float> audio_ring{size_t(2 * g_sample_rate)};
+    SpscRing<CaptureMark> capture_marks{256};
+    uint64_t pushed = 0;               // ring samples; audio thread only
+
+    // Recent audio and the open segment, and speech to disk (--record;
+    // NULL when not recording).
+    std::unique_ptr<CaptureRing<float>> capture;
+    std::unique_ptr<SegmentRecorder> recorder;
+
+    std::atomic<bool> in_speech{false};
+    std::atomic<uint64_t> total_samples{0};        // its global time; never reset
+    std::atomic<uint64_t> last_speech_samples{0};  // last time speech was seen
+    uint64_t speech_start = 0;                     // of the open segment
+
+    // VAD thread: the chunk popped for the next step, and ring bookkeeping.
+    std::vector<float> chunk = std::vector<float>(g_chunk_size);
+    uint64_t seen_dropped = 0;
+    uint64_t popped = 0;               // ring samples consumed
+    CaptureMark mark = { 0, -1 };      // first mark covering the next chunk
+
+    Histogram callback_us;             // audio thread: one data_callback
+    Histogram queue_depth;             // VAD thread: samples waiting per chunk
+    Histogram onset_latency_us;        // VAD thread: capture -> START printed
+    std::atomic<uint64_t> segments{0};         // completed segments handed out
+    std::atomic<uint64_t> segment_pieces{0};   // including partial pieces
+    std::atomic<uint64_t> segment_samples{0};
+};
+
+// Created in main() once the sources are known.
+static std::vector<std::unique_ptr<Source>> g_sources;
+static std::unique_ptr<VadBatchIterator> g_vad;    // one stream per source
+static std::unique_ptr<EventPublisher> g_events;   // --events; NULL when off
+static std::mutex g_mutex;
+
+static int g_pre_roll_ms = 300;
+static int g_capture_s = 30;
+
+static volatile std::sig_atomic_t g_quit_requested = 0;
 
 // Manual reset signaling
 static std::atomic<bool> g_manual_reset_requested{false};
@@ -287,61 +203,225 @@ static std::string g_reset_file = "/tmp/rt_vad_reset";
 // Idle auto-reset seconds (0 = disabled)
 static std::atomic<int> g_idle_reset_seconds{0};
 
+static Histogram g_predict_us;          // VAD thread: one batched predict()
+static Histogram g_batch_streams;       // VAD thread: streams per predict()
+static std::atomic<uint64_t> g_chunks{0};
+
+static std::chrono::steady_clock::time_point g_start_time = std::chrono::steady_clock::now();
+
+static int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - g_start_time).count();
+}
+
+// "[name] " in front of every line once there is more than one source.
+static std::string source_tag(const Source& s) {
+    return g_sources.size() > 1 ? "[" + s.name + "] " : std::string();
+}
+
+// Publishes an event of s with --events. Its wall clock is counted back
+// from the capture time of the audio ending at s.total_samples
+// (captured_us, or now if unknown).
+static void publish_event(const Source& s, VadEvent::Type type, uint64_t sample,
+                          uint64_t length, float probability, int64_t captured_us = -1)
+{
+    if (!g_events)
+        return;
+    VadEvent e = {};
+    e.type = type;
+    e.sample = sample;
+    e.length = length;
+    const int64_t end_wall_us = wall_clock_us() - (captured_us >= 0 ? now_us() - captured_us : 0);
+    e.wall_us = end_wall_us - int64_t((s.total_samples - sample) * 1000000 / uint64_t(g_sample_rate));
+    e.sample_rate = uint32_t(g_sample_rate);
+    e.probability = probability;
+    std::strncpy(e.source, s.name.c_str(), sizeof(e.source) - 1);
+    g_events->publish(e);
+}
+
+// Stats requests and periodic file output
+static volatile std::sig_atomic_t g_stats_requested = 0;
+static std::string g_stats_file;
+static int g_stats_interval = 10;
+
+static void on_stats_signal(int) { g_stats_requested = 1; }
+static void on_quit_signal(int) { g_quit_requested = 1; }
+
+static std::string format_stats() {
+    std::ostringstream out;
+    out << "uptime " << std::fixed << std::setprecision(1) << now_us() / 1e6 << " s"
+        << ", chunks " << g_chunks.load() << "\n"
+        << g_predict_us.summary("predict", "us") << "\n"
+        << g_batch_streams.summary("batch", "") << "\n";
+    if (g_events)
+        out << "events " << g_events->published() << " to " << g_events->subscriber_count()
+            << " subscribers (" << g_events->connected() << " connections), "
+            << g_events->missed() << " missed on full sockets\n";
+    for (const auto& sp : g_sources) {
+        const Source& s = *sp;
+        out << "source " << s.name << ": audio " << s.total_samples.load() / double(g_sample_rate) << " s"
+            << ", overruns " << s.audio_ring.overrun_count()
+            << " (" << s.audio_ring.dropped_count() << " samples dropped)\n"
+            << "capture ring " << (s.capture ? s.capture->capacity() * sizeof(float) / 1024 : 0) << " KiB"
+            << ", pre-roll " << g_pre_roll_ms << " ms"
+            << ", segments " << s.segments.load() << " (" << s.segment_pieces.load() << " pieces, "
+            << s.segment_samples.load() / double(g_sample_rate) << " s)\n";
+        if (s.recorder)
+            out << "recorded " << s.recorder->segments() << " segments ("
+                << s.recorder->samples() / double(g_sample_rate) << " s) to " << s.recorder->directory()
+                << ", " << s.recorder->dropped() / double(g_sample_rate) << " s dropped, "
+                << s.recorder->errors() << " write errors\n";
+        out << s.callback_us.summary("callback", "us") << "\n"
+            << s.queue_depth.summary("queue_depth", "smp") << "\n"
+            << s.onset_latency_us.summary("onset_latency", "us") << "\n";
+    }
+    return out.str();
+}
+
+// Writes via a temporary file so readers never see a partial report.
+static void write_stats_file() {
+    std::string tmp = g_stats_file + ".tmp";
+    {
+        std::ofstream f(tmp);
+        if (!f)
+            return;
+        f << format_stats();
+    }
+    std::rename(tmp.c_str(), g_stats_file.c_str());
+}
+
 
 // ====================================================================
 //  AUDIO CALLBACK
 // ====================================================================
+// Runs on the device's audio thread: no locks, allocation, inference or
+// I/O, just a copy into its source's ring plus the capture time.
 static void data_callback(ma_device* dev,
                           void* output,
                           const void* input,
                           ma_uint32 frameCount)
 {
-    (void)dev;
     (void)output;
+    Source& s = *static_cast<Source*>(dev->pUserData);
 
-    const float* in = (const float*)input;
-    std::lock_guard<std::mutex> lock(g_mutex);
+    int64_t t0 = now_us();
+    if (s.audio_ring.push((const float*)input, frameCount)) {
+        s.pushed += frameCount;
+        CaptureMark mark = { s.pushed, t0 };
+        s.capture_marks.push(&mark, 1);
+    }
+    s.callback_us.record(uint64_t(now_us() - t0));
+}
 
-    ma_uint32 offset = 0;
 
-    while (offset + CHUNK_SIZE <= frameCount)
-    {
-        std::vector<float> chunk(in + offset,
-                                 in + offset + CHUNK_SIZE);
-        offset += CHUNK_SIZE;
-
-        g_vad->predict(chunk);
-        g_total_samples += CHUNK_SIZE;
-
-        // START
-        if (!g_in_speech.load(std::memory_order_relaxed) && g_vad->is_triggered()) {
-            uint64_t abs_start = g_total_samples - CHUNK_SIZE;
-            double t0 = abs_start / double(SAMPLE_RATE);
-            printf("Speech START at %.3f s\n", t0);
-            ring_buffer.clear();
-            g_in_speech.store(true, std::memory_order_relaxed);
-            g_last_speech_samples.store(g_total_samples, std::memory_order_relaxed);
-        }
+// ====================================================================
+//  VAD THREAD
+// ====================================================================
+// Follows one source's chunk after the batched step that ran it.
+// captured_us: capture time of the callback that delivered the chunk's
+// last sample (-1 if unknown).
+static void process_chunk(Source& s, int64_t captured_us)
+{
+    // g_mutex must be held by caller
+    const std::string tag = source_tag(s);
+    s.total_samples += g_chunk_size;
+    s.capture->push(s.chunk.data(), g_chunk_size);
+    const bool triggered = g_vad->is_triggered(s.stream);
+
+    // START
+    if (!s.in_speech.load(std::memory_order_relaxed) && triggered) {
+        uint64_t abs_start = s.total_samples - g_chunk_size;
+        double t0 = abs_start / double(g_sample_rate);
+        publish_event(s, VadEvent::start, abs_start, 0, g_vad->probability(s.stream), captured_us);
+        printf("%sSpeech START at %.3f s\n", tag.c_str(), t0);
+        if (captured_us >= 0)
+            s.onset_latency_us.record(uint64_t(now_us() - captured_us));
+        s.capture->start_segment(abs_start);
+        s.speech_start = abs_start;
+        s.in_speech.store(true, std::memory_order_relaxed);
+        s.last_speech_samples.store(s.total_samples, std::memory_order_relaxed);
+    }
 
-        if (g_in_speech.load(std::memory_order_relaxed)) {
-            ring_buffer.insert(ring_buffer.end(), chunk.begin(), chunk.end());
-        }
+    // END
+    if (s.in_speech.load(std::memory_order_relaxed) && !triggered) {
+        double t1 = s.total_samples / double(g_sample_rate);
+        publish_event(s, VadEvent::end, s.total_samples, s.total_samples - s.speech_start,
+                      g_vad->probability(s.stream), captured_us);
+        printf("%sSpeech END   at %.3f s\n", tag.c_str(), t1);
 
-        // END
-        if (g_in_speech.load(std::memory_order_relaxed) && !g_vad->is_triggered()) {
-            double t1 = g_total_samples / double(SAMPLE_RATE);
-            printf("Speech END   at %.3f s\n", t1);
+        s.in_speech.store(false, std::memory_order_relaxed);
+        s.capture->end_segment(s.total_samples);
+        g_vad->reset_stream(s.stream);
 
-            g_in_speech.store(false, std::memory_order_relaxed);
-            ring_buffer.clear();
-            g_vad->reset();
+        s.last_speech_samples.store(s.total_samples, std::memory_order_relaxed);
+    }
 
-            g_last_speech_samples.store(g_total_samples, std::memory_order_relaxed);
+    // If still in speech, update "last seen" marker continuously.
+    if (g_vad->is_triggered(s.stream)) {
+        s.last_speech_samples.store(s.total_samples, std::memory_order_relaxed);
+    }
+}
+
+// Reports and skips audio the source's ring dropped. Dropped audio still
+// advances its clock so later timestamps stay aligned with the device.
+static void account_overrun(Source& s)
+{
+    uint64_t dropped = s.audio_ring.dropped_count();
+    if (dropped == s.seen_dropped)
+        return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    s.total_samples += dropped - s.seen_dropped;
+    s.capture->skip(dropped - s.seen_dropped);
+    publish_event(s, VadEvent::overrun, s.total_samples, dropped - s.seen_dropped, 0.0f);
+    printf("%s(overrun: %llu samples dropped, %llu total) at %.3f s\n",
+           source_tag(s).c_str(),
+           (unsigned long long)(dropped - s.seen_dropped),
+           (unsigned long long)dropped,
+           s.total_samples.load() / double(g_sample_rate));
+    fflush(stdout);
+    s.seen_dropped = dropped;
+}
+
+// Takes one chunk from every source that has one and runs them as one
+// batch; a source whose device is behind sits the step out and keeps its
+// state. Devices run on their own clocks, so a source that has fallen
+// behind catches up over the next steps.
+static void vad_thread()
+{
+    const size_t n = g_sources.size();
+    std::vector<const float*> chunks(n, nullptr);
+    std::vector<int64_t> captured_us(n, -1);
+
+    while (true) {
+        int ready = 0;
+        for (size_t i = 0; i < n; i++) {
+            Source& s = *g_sources[i];
+            account_overrun(s);
+            chunks[i] = nullptr;
+            size_t depth = s.audio_ring.available();
+            if (!s.audio_ring.pop(s.chunk.data(), g_chunk_size))
+                continue;
+            s.queue_depth.record(depth);
+            s.popped += g_chunk_size;
+            while (s.mark.end < s.popped && s.capture_marks.pop(&s.mark, 1)) { }
+            captured_us[i] = s.mark.end >= s.popped ? s.mark.time_us : -1;
+            chunks[i] = s.chunk.data();
+            ready++;
+        }
+        if (ready == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
         }
 
-        // If still in speech, update "last seen" marker continuously.
-        if (g_vad->is_triggered()) {
-            g_last_speech_samples.store(g_total_samples, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(g_mutex);
+        int64_t predict_start = now_us();
+        g_vad->predict(chunks.data());
+        g_predict_us.record(uint64_t(now_us() - predict_start));
+        g_batch_streams.record(uint64_t(ready));
+        g_chunks++;
+        for (size_t i = 0; i < n; i++) {
+            if (chunks[i])
+                process_chunk(*g_sources[i], captured_us[i]);
         }
     }
 }
@@ -363,24 +443,25 @@ static void remove_file(const std::string& path) {
     std::remove(path.c_str());
 }
 
-static void do_reset_locked(const char* reason_tag)
+static void do_reset_locked(Source& s, const char* reason_tag)
 {
     // g_mutex must be held by caller
     (void)reason_tag;
-    ring_buffer.clear();
-    g_vad->reset();
-    g_in_speech.store(false, std::memory_order_relaxed);
-    // Do NOT reset g_total_samples (global time)
+    s.capture->end_segment(s.total_samples);
+    g_vad->reset_stream(s.stream);
+    s.in_speech.store(false, std::memory_order_relaxed);
+    // Do NOT reset total_samples (global time)
     // Update last speech marker to "now" so we don't instantly fire idle-reset again.
-    g_last_speech_samples.store(g_total_samples, std::memory_order_relaxed);
+    s.last_speech_samples.store(s.total_samples, std::memory_order_relaxed);
 }
 
-static void do_reset_with_log(const char* reason_tag)
+static void do_reset_with_log(Source& s, const char* reason_tag)
 {
     std::lock_guard<std::mutex> lock(g_mutex);
-    do_reset_locked(reason_tag);
-    double t = g_total_samples.load() / double(SAMPLE_RATE);
-    printf("%s at %.3f s\n", reason_tag, t);
+    do_reset_locked(s, reason_tag);
+    publish_event(s, VadEvent::reset, s.total_samples, 0, 0.0f);
+    double t = s.total_samples.load() / double(g_sample_rate);
+    printf("%s%s at %.3f s\n", source_tag(s).c_str(), reason_tag, t);
     fflush(stdout);
 }
 
@@ -412,6 +493,68 @@ static void reset_monitor_thread()
     }
 }
 
+// Picks the capture device of one --source entry: "mic" is the default
+// capture device, "dt" the first desktop monitor (PulseAudio/PipeWire),
+// anything else the first capture device whose name contains it, ignoring
+// case. Returns false if nothing matches.
+static bool find_capture_device(ma_context& ctx, Source& s)
+{
+    if (s.name == "mic") {
+        s.use_device_id = false;
+        return true;
+    }
+
+    ma_device_info* playback_devs;
+    ma_uint32 playback_count;
+    ma_device_info* capture_devs;
+    ma_uint32 capture_count;
+
+    ma_context_get_devices(&ctx,
+                           &playback_devs, &playback_count,
+                           &capture_devs, &capture_count);
+
+    std::string wanted = s.name;
+    std::transform(wanted.begin(), wanted.end(), wanted.begin(), ::tolower);
+
+    for (ma_uint32 i = 0; i < capture_count; i++) {
+        std::string name = capture_devs[i].name;
+
+        // Normalize lowercase
+        std::string low = name;
+        std::transform(low.begin(), low.end(), low.begin(), ::tolower);
+
+        bool match;
+        if (s.name == "dt") {
+            match = low.find("monitor") != std::string::npos ||
+                    (low.find("alsa_output") != std::string::npos &&
+                     low.rfind(".monitor") != std::string::npos);
+        } else {
+            match = low.find(wanted) != std::string::npos;
+        }
+        if (match) {
+            s.device_id = capture_devs[i].id;
+            s.use_device_id = true;
+            if (s.name == "dt")
+                std::cout << "Using desktop audio source: " << name << "\n";
+            else
+                std::cout << "Using capture device for " << s.name << ": " << name << "\n";
+            return true;
+        }
+    }
+    return false;
+}
+
+// Tags are used in file names; keep them to letters, digits, - and _.
+static std::string file_safe(const std::string& name)
+{
+    std::string out = name;
+    for (char& c : out) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_')
+            c = '_';
+    }
+    return out;
+}
+
 
 // ====================================================================
 //  MAIN
@@ -419,8 +562,12 @@ static void reset_monitor_thread()
 int main(int argc, char** argv)
 {
     // Parse simple CLI flags: --idle-reset=SECONDS and --reset-file=PATH
-    std::string source = "mic";   // default
-    
+    std::string source = "mic";   // default; comma-separated for several
+    bool tune = false, retune = false, int8 = false;
+    std::string record_dir;       // empty: not recording
+    std::string events_path;      // empty: no event channel
+    SegmentRecorder::Mode record_mode = SegmentRecorder::Mode::segments;
+
     for (int i = 1; i < argc; ++i) {
         std::string a = argv[i];
         if (a.rfind("--source=", 0) == 0) {
@@ -430,99 +577,177 @@ int main(int argc, char** argv)
             g_idle_reset_seconds.store(sec);
         } else if (a.rfind("--reset-file=", 0) == 0) {
             g_reset_file = a.substr(13);
+        } else if (a == "--tune") {
+            tune = true;
+        } else if (a == "--retune") {
+            tune = retune = true;
+        } else if (a == "--int8") {
+            int8 = true;
+        } else if (a.rfind("--sample-rate=", 0) == 0) {
+            g_sample_rate = std::atoi(a.c_str() + 14);
+            if (g_sample_rate != 16000 && g_sample_rate != 8000) {
+                std::cerr << "ERROR: --sample-rate must be 16000 or 8000\n";
+                return 1;
+            }
+            g_chunk_size = g_sample_rate / 1000 * 32;
+        } else if (a.rfind("--stats-file=", 0) == 0) {
+            g_stats_file = a.substr(13);
+        } else if (a.rfind("--stats-interval=", 0) == 0) {
+            g_stats_interval = std::max(1, std::atoi(a.c_str() + 17));
+        } else if (a.rfind("--pre-roll-ms=", 0) == 0) {
+            g_pre_roll_ms = std::max(0, std::atoi(a.c_str() + 14));
+        } else if (a.rfind("--capture-s=", 0) == 0) {
+            g_capture_s = std::max(1, std::atoi(a.c_str() + 12));
+        } else if (a == "--record") {
+            const char* home = std::getenv("HOME");
+            record_dir = std::string(home ? home : ".") + "/.transcription";
+        } else if (a.rfind("--record=", 0) == 0) {
+            record_dir = a.substr(9);
+        } else if (a == "--events") {
+            events_path = default_event_path();
+        } else if (a.rfind("--events=", 0) == 0) {
+            events_path = a.substr(9);
+        } else if (a == "--record-mode=segments") {
+            record_mode = SegmentRecorder::Mode::segments;
+        } else if (a == "--record-mode=stream") {
+            record_mode = SegmentRecorder::Mode::stream;
         } else {
             std::cerr << "Unknown arg: " << a << "\n";
         }
     }
 
+    // One Source per --source entry
+    std::stringstream entries(source);
+    for (std::string name; std::getline(entries, name, ',');) {
+        if (name.empty())
+            continue;
+        g_sources.push_back(std::make_unique<Source>());
+        g_sources.back()->name = name;
+        g_sources.back()->stream = static_cast<int>(g_sources.size()) - 1;
+    }
+    if (g_sources.empty()) {
+        std::cerr << "ERROR: --source needs at least one entry (mic, dt or a device name).\n";
+        return 1;
+    }
+
     // Model path (system-installed)
-    const char* model_path = "/usr/local/share/silero-vad/silero_vad.onnx";
+    std::string model_path = "/usr/local/share/silero-vad/silero_vad.onnx";
+    if (int8 && g_sample_rate != 16000) {
+        std::cerr << "ERROR: the INT8 model serves 16 kHz only.\n";
+        return 1;
+    }
+    if (int8)
+        model_path = int8_model_path(model_path);
+
+    // Init VAD: one batch stream per source, so one model and one set of
+    // ORT threads serve every device. Tuning times that batch size.
+    EngineConfig engine;
+    if (tune) {
+        engine = auto_engine_config(model_path, 0, retune, g_sample_rate, static_cast<int>(g_sources.size()));
+    }
+    g_vad = std::make_unique<VadBatchIterator>(model_path, static_cast<int>(g_sources.size()),
+                                               g_sample_rate, 32, 0.5f, 100, 30, 250,
+                                               INFINITY, engine);
+
+    // Segment audio is handed out here as spans into each source's capture
+    // ring and, with --record, queued for its writer thread.
+    const size_t pre_roll = size_t(g_pre_roll_ms) * g_sample_rate / 1000;
+    for (auto& sp : g_sources) {
+        Source* s = sp.get();
+        s->capture = std::make_unique<CaptureRing<float>>(pre_roll + size_t(g_capture_s) * g_sample_rate, pre_roll);
+        if (!record_dir.empty()) {
+            // Room for two full pieces: one being written, the next arriving.
+            // With several sources each records under its own name.
+            s->recorder = std::make_unique<SegmentRecorder>(record_dir, record_mode, g_sample_rate,
+                                                            2 * s->capture->capacity(),
+                                                            g_sources.size() > 1 ? file_safe(s->name) : "");
+            if (!s->recorder->start())
+                return 1;
+        }
+        s->capture->set_sink([s](const CaptureRing<float>::Span& span, bool final) {
+            s->segment_pieces++;
+            s->segment_samples += span.length();
+            if (final)
+                s->segments++;
+            if (s->recorder)
+                s->recorder->submit(span, final);
+        });
+    }
+
+    // Events go out from the VAD thread as they happen; subscribers come
+    // and go on the publisher's own thread.
+    if (!events_path.empty()) {
+        g_events = std::make_unique<EventPublisher>(events_path);
+        if (!g_events->start())
+            return 1;
+    }
 
-    // Init VAD
-    g_vad = std::make_unique<VadIterator>(model_path);
-    
     // -----------------------------------------------------------
-    // Select audio source: mic (default) or dt (desktop monitor)
+    // Select audio sources: mic (default), dt (desktop monitor) or a
+    // capture device name
     // -----------------------------------------------------------
     ma_context ctx;
     ma_context_init(NULL, 0, NULL, &ctx);
-    
-    ma_device_id selected_id = {};
-    bool use_specific_id = false;
-    
-    if (source == "dt") {
-        ma_device_info* playback_devs;
-        ma_uint32 playback_count;
-        ma_device_info* capture_devs;
-        ma_uint32 capture_count;
-    
-        ma_context_get_devices(&ctx,
-                               &playback_devs, &playback_count,
-                               &capture_devs, &capture_count);
-    
-        // Find a PulseAudio/PipeWire monitor source
-        bool found = false;
-        
-        for (ma_uint32 i = 0; i < capture_count; i++) {
-            std::string name = capture_devs[i].name;
-        
-            // Normalize lowercase
-            std::string low = name;
-            std::transform(low.begin(), low.end(), low.begin(), ::tolower);
-        
-            if (low.find("monitor") != std::string::npos ||
-                (low.find("alsa_output") != std::string::npos &&
-                 low.rfind(".monitor") != std::string::npos))
-            {
-                selected_id = capture_devs[i].id;
-                use_specific_id = true;
-                found = true;
-                std::cout << "Using desktop audio source: " << name << "\n";
-                break;
-            }
-        }
-        
-        if (!found) {
-            std::cerr << "ERROR: --source=dt requested, but no monitor device found.\n";
+
+    for (auto& sp : g_sources) {
+        if (!find_capture_device(ctx, *sp)) {
+            if (sp->name == "dt")
+                std::cerr << "ERROR: --source=dt requested, but no monitor device found.\n";
+            else
+                std::cerr << "ERROR: no capture device matches --source entry '" << sp->name << "'.\n";
             return 1;
         }
     }
-    
+
     // -----------------------------------------------------------
-    // Configure miniaudio device
+    // Configure one miniaudio device per source
     // -----------------------------------------------------------
-    ma_device_config cfg =
-        ma_device_config_init(ma_device_type_capture);
-    
-    cfg.capture.format     = ma_format_f32;
-    cfg.capture.channels   = 1;
-    cfg.sampleRate         = SAMPLE_RATE;
-    cfg.periodSizeInFrames = CHUNK_SIZE;
-    cfg.noPreSilencedOutputBuffer = MA_TRUE;
-    cfg.dataCallback       = data_callback;
-    
-    ma_device device;
-    
-    // If a specific capture device (desktop monitor) was found:
-    if (use_specific_id) {
-        cfg.capture.pDeviceID = &selected_id;
-    }
-    
-    ma_result r = ma_device_init(&ctx, &cfg, &device);
-    if (r != MA_SUCCESS) {
-        std::cerr << "ERROR: cannot open capture device\n";
-        return 1;
-    }
-    
-    if (ma_device_start(&device) != MA_SUCCESS) {
-        std::cerr << "ERROR: cannot start capture device\n";
-        ma_device_uninit(&device);
-        return 1;
+    size_t started = 0;
+    for (auto& sp : g_sources) {
+        Source& s = *sp;
+        ma_device_config cfg =
+            ma_device_config_init(ma_device_type_capture);
+
+        cfg.capture.format     = ma_format_f32;
+        cfg.capture.channels   = 1;
+        cfg.sampleRate         = g_sample_rate;
+        cfg.periodSizeInFrames = g_chunk_size;
+        cfg.noPreSilencedOutputBuffer = MA_TRUE;
+        cfg.dataCallback       = data_callback;
+        cfg.pUserData          = &s;
+
+        // If a specific capture device (desktop monitor, named device) was found:
+        if (s.use_device_id) {
+            cfg.capture.pDeviceID = &s.device_id;
+        }
+
+        ma_result r = ma_device_init(&ctx, &cfg, &s.device);
+        if (r != MA_SUCCESS) {
+            std::cerr << "ERROR: cannot open capture device for " << s.name << "\n";
+            for (size_t k = 0; k < started; k++)
+                ma_device_uninit(&g_sources[k]->device);
+            return 1;
+        }
+
+        if (ma_device_start(&s.device) != MA_SUCCESS) {
+            std::cerr << "ERROR: cannot start capture device for " << s.name << "\n";
+            ma_device_uninit(&s.device);
+            for (size_t k = 0; k < started; k++)
+                ma_device_uninit(&g_sources[k]->device);
+            return 1;
+        }
+        started++;
     }
-    
+
     std::cout << "Listening with GLOBAL timestamps... Ctrl-C to exit.\n";
+    if (g_sources.size() > 1) {
+        std::cout << "Sources:";
+        for (const auto& sp : g_sources)
+            std::cout << " [" << sp->name << "]";
+        std::cout << "\n";
+    }
     std::cout << "Manual reset: press ENTER or touch " << g_reset_file << "\n";
-    
+
     if (g_idle_reset_seconds.load() > 0) {
         std::cout << "Idle auto-reset: "
                   << g_idle_reset_seconds.load()
@@ -533,31 +758,84 @@ int main(int argc, char** argv)
 std::thread monitor(reset_monitor_thread);
 monitor.detach();
 
+    // Inference runs here, fed by the audio callbacks through the rings
+    std::thread vad_worker(vad_thread);
+    vad_worker.detach();
+
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, on_stats_signal);
+    std::cout << "Timing stats: kill -USR1 " << getpid() << "\n";
+#endif
+    if (!g_stats_file.empty()) {
+        std::cout << "Timing stats every " << g_stats_interval << "s to " << g_stats_file << "\n";
+    }
+    if (!record_dir.empty() || g_events) {
+        std::signal(SIGINT, on_quit_signal);
+        std::signal(SIGTERM, on_quit_signal);
+    }
+    if (!record_dir.empty()) {
+        std::cout << "Recording speech to " << record_dir << "\n";
+    }
+    if (g_events) {
+        std::cout << "Publishing events on " << g_events->socket_path() << "\n";
+    }
+    int64_t next_stats_us = int64_t(g_stats_interval) * 1000000;
+
     // Main management loop
-    while (true) {
-        // Manual reset?
+    while (!g_quit_requested) {
+        // Manual reset? It applies to every source.
         if (g_manual_reset_requested.exchange(false)) {
-            do_reset_with_log("(manual reset invoked)");
+            for (auto& sp : g_sources)
+                do_reset_with_log(*sp, "(manual reset invoked)");
         }
 
-        // Idle auto-reset?
+        // Idle auto-reset? Each source idles on its own.
         int idleSec = g_idle_reset_seconds.load();
         if (idleSec > 0) {
-            bool inSpeech = g_in_speech.load(std::memory_order_relaxed);
-            if (!inSpeech) {
-                uint64_t last = g_last_speech_samples.load(std::memory_order_relaxed);
-                uint64_t now  = g_total_samples.load(std::memory_order_relaxed);
-                double idle_elapsed_s = (now - last) / double(SAMPLE_RATE);
-                if (idle_elapsed_s >= idleSec) {
-                    do_reset_with_log("(silence reset)");
+            for (auto& sp : g_sources) {
+                Source& s = *sp;
+                bool inSpeech = s.in_speech.load(std::memory_order_relaxed);
+                if (!inSpeech) {
+                    uint64_t last = s.last_speech_samples.load(std::memory_order_relaxed);
+                    uint64_t now  = s.total_samples.load(std::memory_order_relaxed);
+                    double idle_elapsed_s = (now - last) / double(g_sample_rate);
+                    if (idle_elapsed_s >= idleSec) {
+                        do_reset_with_log(s, "(silence reset)");
+                    }
                 }
             }
         }
 
+        // Timing stats on request / on schedule
+        if (g_stats_requested) {
+            g_stats_requested = 0;
+            std::cerr << format_stats() << std::flush;
+        }
+        if (!g_stats_file.empty() && now_us() >= next_stats_us) {
+            write_stats_file();
+            next_stats_us += int64_t(g_stats_interval) * 1000000;
+        }
+
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
-    // never reached
-    ma_device_uninit(&device);
-    return 0;
+    // Only reached when recording or publishing: close the open segments,
+    // let the writers finish the files and remove the socket. The detached
+    // threads still hold the globals, so leave without running static
+    // destructors.
+    for (auto& sp : g_sources)
+        ma_device_uninit(&sp->device);
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (auto& sp : g_sources) {
+            sp->capture->end_segment(sp->total_samples);
+            if (sp->recorder)
+                sp->recorder->stop();
+        }
+        if (g_events)
+            g_events->stop();
+    }
+    std::cerr << format_stats() << std::flush;
+    std::fflush(stdout);
+    std::_Exit(0);
 }
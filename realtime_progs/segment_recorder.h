@@ -0,0 +1,292 @@
+#ifndef SEGMENT_RECORDER_H_
+#define SEGMENT_RECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+
+#include "spsc_ring.h"
+#include "capture_ring.h"
+#include "../wav.h"
+
+// SegmentRecorder: writes speech to disk from a thread of its own, so the
+// capture and inference threads never wait on the disk. submit() runs on
+// the inference thread as the CaptureRing sink: it copies the span into
+// preallocated blocks and queues them, lock-free; the writer thread
+// drains the queue in batches through WavFileWriter's block buffer. If
+// the disk falls behind by more than queue_samples of speech, audio is
+// dropped and counted rather than waited for; the queue should hold at
+// least two of the CaptureRing's pieces.
+//
+// Mode::segments writes one file per segment, dir/speech_<time>.wav;
+// Mode::stream appends all segments to one dir/speech_<time>.wav per run,
+// with a cue point at each. Either way dir/index.tsv gets one line per
+// segment:
+//
+//   file  offset_s  start_s  end_s  wall_clock
+//
+// offset_s is where the segment starts in the file, start_s and end_s are
+// the capture clock (the tool's global timestamps), wall_clock is local
+// time at the segment start. Recorders of several sources can share dir
+// under different names: the files become speech_<name>_<time>.wav and
+// the index index_<name>.tsv.
+class SegmentRecorder {
+public:
+    enum class Mode { segments, stream };
+
+private:
+    static const size_t kBlockSamples = 8192;
+
+    struct Block {
+        float samples[kBlockSamples];
+        size_t n;
+        uint64_t start;         // capture position of samples[0]
+        int64_t wall_ms;        // wall clock at start (first block only)
+        bool first;             // begins a segment
+        bool final;             // ends it
+    };
+
+    std::string dir;
+    std::string name;               // "" or "_<name>", in file names
+    Mode mode;
+    int sample_rate;
+
+    std::vector<std::unique_ptr<Block>> pool;
+    SpscRing<Block*> free_blocks;   // writer -> inference thread
+    SpscRing<Block*> ready_blocks;  // inference thread -> writer
+
+    // Inference thread only.
+    bool next_first = true;
+    bool queued_first = false;      // this segment's first block is queued
+    bool dropping = false;          // rest of this segment is being dropped
+
+    // Writer thread only.
+    wav::WavFileWriter writer;
+    std::string file_name;          // current file, relative to dir
+    FILE* index = NULL;
+    bool seg_open = false;
+    uint64_t seg_start = 0;
+    uint64_t seg_end = 0;           // end of what was written so far
+    uint64_t seg_offset = 0;        // frames into the file
+    int64_t seg_wall_ms = 0;
+
+    std::thread thread;
+    std::atomic<bool> stop_requested{false};
+    std::atomic<uint64_t> written_segments{0};
+    std::atomic<uint64_t> written_samples{0};
+    std::atomic<uint64_t> dropped_samples{0};
+    std::atomic<uint64_t> write_errors{0};
+
+    static int64_t wall_now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static std::string format_time(int64_t ms, const char* fmt) {
+        std::time_t t = static_cast<std::time_t>(ms / 1000);
+        std::tm tm;
+#if defined(_WIN32)
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        char buf[64];
+        std::strftime(buf, sizeof(buf), fmt, &tm);
+        char out[80];
+        std::snprintf(out, sizeof(out), "%s.%03d", buf, static_cast<int>(ms % 1000));
+        return out;
+    }
+
+    bool open_file(int64_t wall_ms) {
+        file_name = "speech" + name + "_" + format_time(wall_ms, "%Y%m%d-%H%M%S") + ".wav";
+        const std::string path = (std::filesystem::path(dir) / file_name).string();
+        if (!writer.Open(path, sample_rate, 1)) {
+            std::fprintf(stderr, "recorder: cannot write %s\n", path.c_str());
+            write_errors++;
+            return false;
+        }
+        return true;
+    }
+
+    void begin_segment(const Block& b) {
+        if (seg_open)                   // its final block was dropped
+            end_segment();
+        seg_open = true;
+        seg_start = seg_end = b.start;
+        seg_wall_ms = b.wall_ms;
+        if (mode == Mode::segments || !writer.is_open())
+            open_file(b.wall_ms);
+        if (writer.is_open()) {
+            seg_offset = writer.num_frames();
+            if (mode == Mode::stream)
+                writer.AddCue();
+        }
+    }
+
+    void end_segment() {
+        seg_open = false;
+        if (!writer.is_open())
+            return;
+        bool ok = mode == Mode::segments ? writer.Close() : writer.Sync();
+        if (!ok)
+            write_errors++;
+        if (index) {
+            std::fprintf(index, "%s\t%.3f\t%.3f\t%.3f\t%s\n", file_name.c_str(),
+                         seg_offset / double(sample_rate), seg_start / double(sample_rate),
+                         seg_end / double(sample_rate), format_time(seg_wall_ms, "%Y-%m-%dT%H:%M:%S").c_str());
+            std::fflush(index);
+        }
+        written_segments++;
+    }
+
+    // Writes whatever is queued; returns false if there was nothing.
+    bool drain() {
+        Block* b;
+        bool any = false;
+        while (ready_blocks.pop(&b, 1)) {
+            any = true;
+            if (b->first)
+                begin_segment(*b);
+            if (!seg_open) {
+                // Rest of a segment whose first block was dropped.
+            } else if (writer.is_open() && b->n > 0) {
+                if (!writer.WriteFloat(b->samples, b->n))
+                    write_errors++;
+                written_samples += b->n;
+                seg_end = b->start + b->n;
+            }
+            if (b->final && seg_open)
+                end_segment();
+            free_blocks.push(&b, 1);
+        }
+        return any;
+    }
+
+    void run() {
+        while (!stop_requested.load(std::memory_order_relaxed)) {
+            if (!drain())
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        drain();
+        if (seg_open)
+            end_segment();
+    }
+
+    // Queues one run of samples; the first and final flags go on the
+    // run's first and last block. Once the writer falls behind, the rest
+    // of the segment is dropped; its final flag is still sent, in an
+    // empty block, so the file ends where the last queued block did.
+    void queue(const float* data, size_t n, uint64_t start, bool first, bool final, int64_t wall_ms) {
+        if (n == 0 && !first && !final)
+            return;
+        do {
+            Block* b;
+            if (dropping || !free_blocks.pop(&b, 1)) {
+                dropped_samples += n;
+                dropping = true;
+                if (final && queued_first && free_blocks.pop(&b, 1)) {
+                    b->n = 0;
+                    b->start = start + n;
+                    b->first = false;
+                    b->final = true;
+                    ready_blocks.push(&b, 1);
+                }
+                return;
+            }
+            queued_first = queued_first || first;
+            const size_t take = std::min(n, kBlockSamples);
+            std::copy(data, data + take, b->samples);
+            b->n = take;
+            b->start = start;
+            b->wall_ms = wall_ms;
+            b->first = first;
+            b->final = final && take == n;
+            ready_blocks.push(&b, 1);
+            data += take;
+            start += take;
+            n -= take;
+            first = false;
+        } while (n > 0);
+    }
+
+public:
+    // Up to queue_samples of speech may wait for the disk.
+    SegmentRecorder(const std::string& Dir, Mode Mode_, int Sample_rate, size_t queue_samples,
+                    const std::string& Name = "")
+        : dir(Dir), name(Name.empty() ? "" : "_" + Name), mode(Mode_), sample_rate(Sample_rate),
+          free_blocks(queue_samples / kBlockSamples + 2),
+          ready_blocks(free_blocks.capacity())
+    {
+        const size_t blocks = queue_samples / kBlockSamples + 2;
+        for (size_t i = 0; i < blocks; i++) {
+            pool.push_back(std::make_unique<Block>());
+            Block* b = pool.back().get();
+            free_blocks.push(&b, 1);
+        }
+    }
+
+    ~SegmentRecorder() { stop(); }
+
+    SegmentRecorder(const SegmentRecorder&) = delete;
+    SegmentRecorder& operator=(const SegmentRecorder&) = delete;
+
+    // Creates dir and the index and starts the writer thread.
+    bool start() {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        const std::string index_path = (std::filesystem::path(dir) / ("index" + name + ".tsv")).string();
+        const bool fresh = !std::filesystem::exists(index_path, ec);
+        index = std::fopen(index_path.c_str(), "a");
+        if (index == NULL) {
+            std::fprintf(stderr, "recorder: cannot write %s\n", index_path.c_str());
+            return false;
+        }
+        if (fresh)
+            std::fprintf(index, "file\toffset_s\tstart_s\tend_s\twall_clock\n");
+        thread = std::thread(&SegmentRecorder::run, this);
+        return true;
+    }
+
+    // Writes out what is queued and closes the files.
+    void stop() {
+        if (thread.joinable()) {
+            stop_requested = true;
+            thread.join();
+        }
+        writer.Close();
+        if (index) {
+            std::fclose(index);
+            index = NULL;
+        }
+    }
+
+    // CaptureRing sink, on the inference thread: never blocks.
+    void submit(const CaptureRing<float>::Span& span, bool final) {
+        const bool first = next_first;
+        const int64_t wall_ms = wall_now_ms() - static_cast<int64_t>(span.length()) * 1000 / sample_rate;
+        if (first)
+            dropping = queued_first = false;
+        if (span.size[1] == 0) {
+            queue(span.data[0], span.size[0], span.start, first, final, wall_ms);
+        } else {
+            queue(span.data[0], span.size[0], span.start, first, false, wall_ms);
+            queue(span.data[1], span.size[1], span.start + span.size[0], false, final, wall_ms);
+        }
+        next_first = final;
+    }
+
+    const std::string& directory() const { return dir; }
+    uint64_t segments() const { return written_segments.load(std::memory_order_relaxed); }
+    uint64_t samples() const { return written_samples.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_samples.load(std::memory_order_relaxed); }
+    uint64_t errors() const { return write_errors.load(std::memory_order_relaxed); }
+};
+
+#endif  // SEGMENT_RECORDER_H_
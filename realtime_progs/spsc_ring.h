@@ -0,0 +1,87 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// SpscRing: lock-free single-producer/single-consumer sample ring between
+// the miniaudio callback (producer) and the inference thread (consumer).
+// push() never blocks or allocates, so it is safe on the audio thread; a
+// block that does not fit is dropped whole and counted as an overrun, which
+// the consumer can report from a normal thread.
+template <typename T>
+class SpscRing {
+private:
+    std::vector<T> buf;
+    size_t mask;
+
+    // Monotonic positions; index = pos & mask. Each sits on its own cache
+    // line so producer and consumer do not false-share.
+    alignas(64) std::atomic<size_t> write_pos{0};
+    alignas(64) std::atomic<size_t> read_pos{0};
+    alignas(64) std::atomic<uint64_t> overruns{0};
+    std::atomic<uint64_t> dropped{0};
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+public:
+    // capacity is rounded up to a power of two.
+    explicit SpscRing(size_t capacity)
+        : buf(round_up_pow2(capacity)), mask(buf.size() - 1) { }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return buf.size(); }
+
+    // Producer: appends n items, or drops all of them if there is no room.
+    bool push(const T* data, size_t n) {
+        const size_t w = write_pos.load(std::memory_order_relaxed);
+        const size_t r = read_pos.load(std::memory_order_acquire);
+        if (buf.size() - (w - r) < n) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            dropped.fetch_add(n, std::memory_order_relaxed);
+            return false;
+        }
+        const size_t at = w & mask;
+        const size_t first = std::min(n, buf.size() - at);
+        std::memcpy(buf.data() + at, data, first * sizeof(T));
+        std::memcpy(buf.data(), data + first, (n - first) * sizeof(T));
+        write_pos.store(w + n, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: items ready to pop.
+    size_t available() const {
+        return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_relaxed);
+    }
+
+    // Consumer: pops exactly n items into out, or nothing if fewer are ready.
+    bool pop(T* out, size_t n) {
+        const size_t r = read_pos.load(std::memory_order_relaxed);
+        const size_t w = write_pos.load(std::memory_order_acquire);
+        if (w - r < n)
+            return false;
+        const size_t at = r & mask;
+        const size_t first = std::min(n, buf.size() - at);
+        std::memcpy(out, buf.data() + at, first * sizeof(T));
+        std::memcpy(out + first, buf.data(), (n - first) * sizeof(T));
+        read_pos.store(r + n, std::memory_order_release);
+        return true;
+    }
+
+    // Overrun counters, readable from any thread.
+    uint64_t overrun_count() const { return overruns.load(std::memory_order_relaxed); }
+    uint64_t dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#endif  // SPSC_RING_H_
@@ -1,5 +1,10 @@
 // ====================================================================
 //  Real-time Silero VAD using ONNX Runtime + miniaudio microphone input
+//  The audio callback only pushes samples into a lock-free ring;
+//  inference runs on a separate VAD thread.
+//  --tune / --retune: cached per-machine ONNX Runtime threading
+//  --int8: run the INT8 model (silero_vad.int8.onnx) instead
+//  --sample-rate=8000: capture at 8 kHz, 256-sample windows (default 16000)
 // ====================================================================
 
 #define MINIAUDIO_IMPLEMENTATION
@@ -16,6 +21,10 @@
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
+#include <thread>
+#include <atomic>
+
+#include "spsc_ring.h"
 
 // ---------------------------
 //   WAV Reader for VAD class
@@ -60,183 +69,10 @@ public:
 
 
 // ====================================================================
-//  FULL VAD ITERATOR (your class, unmodified except:
-//      - added is_triggered()
-//      - added get_current_start()
+//  VadIterator and ONNX Runtime session setup, shared with vad
 // ====================================================================
 
-#include "onnxruntime_cxx_api.h"
-
-class timestamp_t {
-public:
-    int start;
-    int end;
-    timestamp_t(int s=-1, int e=-1) : start(s), end(e) {}
-};
-
-class VadIterator {
-private:
-    Ort::Env env;
-    Ort::SessionOptions session_options;
-    std::shared_ptr<Ort::Session> session = nullptr;
-    Ort::AllocatorWithDefaultOptions allocator;
-    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
-
-    const int context_samples = 64;
-    std::vector<float> _context;
-
-    int window_size_samples;
-    int effective_window_size;
-    int sr_per_ms;
-
-    std::vector<Ort::Value> ort_inputs;
-    std::vector<const char*> input_node_names = {"input","state","sr"};
-    std::vector<float> input;
-    unsigned int size_state = 2*1*128;
-    std::vector<float> _state;
-    std::vector<int64_t> sr;
-    int64_t input_node_dims[2] = {};
-    const int64_t state_node_dims[3] = {2,1,128};
-    const int64_t sr_node_dims[1] = {1};
-    std::vector<Ort::Value> ort_outputs;
-    std::vector<const char*> output_node_names = {"output","stateN"};
-
-    int sample_rate;
-    float threshold;
-    int min_silence_samples;
-    int min_silence_samples_at_max_speech;
-    int min_speech_samples;
-    float max_speech_samples;
-    int speech_pad_samples;
-    int audio_length_samples;
-
-    bool triggered = false;
-    unsigned int temp_end = 0;
-    unsigned int current_sample = 0;
-    int prev_end;
-    int next_start = 0;
-    std::vector<timestamp_t> speeches;
-    timestamp_t current_speech;
-
-    void init_engine_threads(int inter, int intra) {
-        session_options.SetIntraOpNumThreads(intra);
-        session_options.SetInterOpNumThreads(inter);
-        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-    }
-
-    void init_onnx_model(const std::string& path) {
-        init_engine_threads(1,1);
-        session = std::make_shared<Ort::Session>(env, path.c_str(), session_options);
-    }
-
-    void reset_states() {
-        std::memset(_state.data(), 0, _state.size()*sizeof(float));
-        triggered=false; temp_end=0; current_sample=0;
-        prev_end=0; next_start=0;
-        speeches.clear();
-        current_speech = timestamp_t();
-        std::fill(_context.begin(), _context.end(), 0.f);
-    }
-
-public:
-    VadIterator(const std::string& ModelPath,
-                int Sample_rate = 16000, int windows_frame = 32,
-                float Threshold = 0.5, int min_silence_ms = 100,
-                int pad_ms = 30, int min_speech_ms = 250,
-                float max_speech_s = INFINITY)
-        : sample_rate(Sample_rate), threshold(Threshold), speech_pad_samples(pad_ms)
-    {
-        sr_per_ms = sample_rate / 1000;
-        window_size_samples = windows_frame * sr_per_ms;
-        effective_window_size = window_size_samples + context_samples;
-        input_node_dims[0] = 1;
-        input_node_dims[1] = effective_window_size;
-
-        _state.resize(size_state);
-        sr.resize(1); sr[0] = sample_rate;
-        _context.assign(context_samples, 0.f);
-
-        min_speech_samples = sr_per_ms * min_speech_ms;
-        max_speech_samples = (sample_rate * max_speech_s - window_size_samples - 2 * speech_pad_samples);
-        min_silence_samples = sr_per_ms * min_silence_ms;
-        min_silence_samples_at_max_speech = sr_per_ms * 98;
-
-        init_onnx_model(ModelPath);
-    }
-
-    void predict(const std::vector<float>& data_chunk) {
-        std::vector<float> new_data(effective_window_size, 0.f);
-        std::copy(_context.begin(), _context.end(), new_data.begin());
-        std::copy(data_chunk.begin(), data_chunk.end(), new_data.begin()+context_samples);
-        input = new_data;
-
-        Ort::Value input_ort =
-            Ort::Value::CreateTensor<float>(memory_info, input.data(),
-                                            input.size(), input_node_dims, 2);
-
-        Ort::Value state_ort =
-            Ort::Value::CreateTensor<float>(memory_info, _state.data(),
-                                            _state.size(), state_node_dims, 3);
-
-        Ort::Value sr_ort =
-            Ort::Value::CreateTensor<int64_t>(memory_info, sr.data(),
-                                              sr.size(), sr_node_dims, 1);
-
-        ort_inputs.clear();
-        ort_inputs.emplace_back(std::move(input_ort));
-        ort_inputs.emplace_back(std::move(state_ort));
-        ort_inputs.emplace_back(std::move(sr_ort));
-
-        ort_outputs = session->Run(Ort::RunOptions{nullptr},
-                    input_node_names.data(), ort_inputs.data(), ort_inputs.size(),
-                    output_node_names.data(), output_node_names.size());
-
-        float speech_prob = ort_outputs[0].GetTensorMutableData<float>()[0];
-        float* stateN = ort_outputs[1].GetTensorMutableData<float>();
-        std::memcpy(_state.data(), stateN, size_state*sizeof(float));
-
-        current_sample += window_size_samples;
-
-        // START
-        if (speech_prob >= threshold) {
-            if (!triggered) {
-                triggered = true;
-                current_speech.start = current_sample - window_size_samples;
-            }
-            std::copy(new_data.end()-context_samples, new_data.end(), _context.begin());
-            return;
-        }
-
-        // END
-        if (triggered && speech_prob < (threshold - 0.15)) {
-            temp_end = (temp_end == 0) ? current_sample : temp_end;
-
-            if ((current_sample - temp_end) >= min_silence_samples) {
-                current_speech.end = temp_end;
-                if (current_speech.end - current_speech.start > min_speech_samples) {
-                    speeches.push_back(current_speech);
-                }
-                triggered = false;
-                temp_end = 0;
-                current_speech = timestamp_t();
-            }
-        }
-
-        std::copy(new_data.end()-context_samples, new_data.end(), _context.begin());
-    }
-
-    const std::vector<timestamp_t> get_speech_timestamps() const {
-        return speeches;
-    }
-
-    void reset() { reset_states(); }
-
-    // --------------------------
-    // additions for real-time VAD
-    // --------------------------
-    bool is_triggered() const { return triggered; }
-    int  get_current_start() const { return current_speech.start; }
-};
+#include "../vad_iterator.h"   // VadIterator, EngineConfig, auto_engine_config()
 
 
 // ====================================================================
@@ -244,56 +80,83 @@ public:
 // ====================================================================
 
 static std::unique_ptr<VadIterator> g_vad;
-static std::mutex g_mutex;
 
-static const int SAMPLE_RATE  = 16000;
-static const int CHUNK_SIZE   = 512;
+// Model rate (--sample-rate=8000 or 16000) and its 32 ms window.
+static int g_sample_rate = 16000;
+static int g_chunk_size  = 512;
 static bool in_speech = false;
 static std::vector<float> ring_buffer;
 
+// Audio thread -> VAD thread; 2 s of slack at 16 kHz (4 s at 8 kHz)
+// before the callback drops audio.
+static SpscRing<float> g_audio_ring(2 * 16000);
+
 
 // ------------------------------------------------------------
-//  Audio callback (runs in audio thread)
+//  Audio callback (runs in audio thread): only copies into the ring
 // ------------------------------------------------------------
 static void data_callback(ma_device* dev, void* output,
                           const void* input, ma_uint32 frameCount)
 {
+    (void)dev;
     (void)output;
-    const float* in = (const float*)input;
+    g_audio_ring.push((const float*)input, frameCount);
+}
 
-    std::lock_guard<std::mutex> lock(g_mutex);
 
-    ma_uint32 offset = 0;
-    while (offset + CHUNK_SIZE <= frameCount) {
-        std::vector<float> chunk(in + offset, in + offset + CHUNK_SIZE);
-        offset += CHUNK_SIZE;
+// ------------------------------------------------------------
+//  VAD thread: inference and output, one chunk at a time
+// ------------------------------------------------------------
+static void process_chunk(const float* chunk)
+{
+    g_vad->feed(chunk, g_chunk_size);
+
+    // START
+    if (!in_speech && g_vad->is_triggered()) {
+        double t0 = g_vad->get_current_start() / double(g_sample_rate);
+        printf("Speech START at %.3f s\n", t0);
+        ring_buffer.clear();
+        in_speech = true;
+    }
 
-        g_vad->predict(chunk);
+    if (in_speech) {
+        ring_buffer.insert(ring_buffer.end(), chunk, chunk + g_chunk_size);
+    }
 
-        // START
-        if (!in_speech && g_vad->is_triggered()) {
-            double t0 = g_vad->get_current_start() / double(SAMPLE_RATE);
-            printf("Speech START at %.3f s\n", t0);
-            ring_buffer.clear();
-            in_speech = true;
+    // END
+    if (in_speech && !g_vad->is_triggered()) {
+        auto segs = g_vad->get_speech_timestamps();
+        if (!segs.empty()) {
+            auto ts = segs.back();
+            double t1 = ts.end / double(g_sample_rate);
+            printf("Speech END   at %.3f s\n", t1);
         }
+        in_speech = false;
+        ring_buffer.clear();
+        g_vad->reset();
+    }
+}
+
+static void vad_thread()
+{
+    std::vector<float> chunk(g_chunk_size);
+    uint64_t seen_dropped = 0;
 
-        if (in_speech) {
-            ring_buffer.insert(ring_buffer.end(), chunk.begin(), chunk.end());
+    while (true) {
+        uint64_t dropped = g_audio_ring.dropped_count();
+        if (dropped != seen_dropped) {
+            printf("(overrun: %llu samples dropped, %llu total)\n",
+                   (unsigned long long)(dropped - seen_dropped),
+                   (unsigned long long)dropped);
+            fflush(stdout);
+            seen_dropped = dropped;
         }
 
-        // END
-        if (in_speech && !g_vad->is_triggered()) {
-            auto segs = g_vad->get_speech_timestamps();
-            if (!segs.empty()) {
-                auto ts = segs.back();
-                double t1 = ts.end / double(SAMPLE_RATE);
-                printf("Speech END   at %.3f s\n", t1);
-            }
-            in_speech = false;
-            ring_buffer.clear();
-            g_vad->reset();
+        if (!g_audio_ring.pop(chunk.data(), g_chunk_size)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
         }
+        process_chunk(chunk.data());
     }
 }
 
@@ -301,17 +164,50 @@ static void data_callback(ma_device* dev, void* output,
 // ------------------------------------------------------------
 //  MAIN
 // ------------------------------------------------------------
-int main()
+int main(int argc, char** argv)
 {
+    std::string model_path = "/usr/local/share/silero-vad/silero_vad.onnx";
+
+    bool tune = false, retune = false, int8 = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--tune" || a == "--retune") {
+            tune = true;
+            retune = retune || a == "--retune";
+        } else if (a == "--int8") {
+            int8 = true;
+        } else if (a.rfind("--sample-rate=", 0) == 0) {
+            g_sample_rate = std::atoi(a.c_str() + 14);
+            if (g_sample_rate != 16000 && g_sample_rate != 8000) {
+                std::cerr << "ERROR: --sample-rate must be 16000 or 8000\n";
+                return 1;
+            }
+            g_chunk_size = g_sample_rate / 1000 * 32;
+        } else {
+            std::cerr << "Unknown arg: " << a << "\n";
+        }
+    }
+
+    if (int8 && g_sample_rate != 16000) {
+        std::cerr << "ERROR: the INT8 model serves 16 kHz only\n";
+        return 1;
+    }
+    if (int8)
+        model_path = int8_model_path(model_path);
+
+    EngineConfig engine;
+    if (tune)
+        engine = auto_engine_config(model_path, 0, retune, g_sample_rate);
+
     g_vad = std::make_unique<VadIterator>(
-        "/usr/local/share/silero-vad/silero_vad.onnx"
+        model_path, g_sample_rate, 32, 0.5f, 100, 30, 250, INFINITY, engine
     );
 
     ma_device_config cfg = ma_device_config_init(ma_device_type_capture);
     cfg.capture.format        = ma_format_f32;
     cfg.capture.channels      = 1;
-    cfg.sampleRate            = SAMPLE_RATE;
-    cfg.periodSizeInFrames    = CHUNK_SIZE;
+    cfg.sampleRate            = g_sample_rate;
+    cfg.periodSizeInFrames    = g_chunk_size;
     cfg.noPreSilencedOutputBuffer = MA_TRUE;
     cfg.dataCallback          = data_callback;
 
@@ -329,6 +225,9 @@ int main()
 
     std::cout << "Listening...  Ctrl-C to exit.\n";
 
+    std::thread vad_worker(vad_thread);
+    vad_worker.detach();
+
     while (true) {
         ma_sleep(1000);
     }
@@ -0,0 +1,95 @@
+// vad_events.cpp — prints the events rt_vad_global_reset publishes with
+// --events, one line each, as they happen:
+//
+//   type  source  time_s  length_s  probability  wall_clock  delay_ms
+//
+// time_s is on the source's clock (as in the tool's own output), length_s
+// the segment length for END and the dropped audio for OVERRUN, wall_clock
+// local time at time_s and delay_ms the time from publish to receipt.
+// Any number of these (or other subscribers) can run at once.
+//
+//   vad_events [--events=PATH] [--source=NAME] [--follow]
+//
+// --follow waits for the publisher to appear and reconnects when it goes.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "event_channel.h"
+
+// "YYYY-mm-ddTHH:MM:SS.mmm" in local time
+static std::string format_wall(int64_t us)
+{
+    std::time_t t = static_cast<std::time_t>(us / 1000000);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    char out[40];
+    std::snprintf(out, sizeof(out), "%s.%03d", buf, static_cast<int>(us / 1000 % 1000));
+    return out;
+}
+
+int main(int argc, char** argv)
+{
+    std::string path = default_event_path();
+    std::string source;            // empty: every source
+    bool follow = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.rfind("--events=", 0) == 0) {
+            path = a.substr(9);
+        } else if (a.rfind("--source=", 0) == 0) {
+            source = a.substr(9);
+        } else if (a == "--follow") {
+            follow = true;
+        } else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 1;
+        }
+    }
+
+    EventSubscriber sub;
+    uint64_t last_seq = 0;
+    while (true) {
+        if (!sub.connected()) {
+            if (sub.connect(path)) {
+                std::fprintf(stderr, "(connected to %s)\n", path.c_str());
+                last_seq = 0;
+            } else if (follow) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                continue;
+            } else {
+                std::fprintf(stderr, "ERROR: no publisher at %s\n", path.c_str());
+                return 1;
+            }
+        }
+
+        VadEvent e;
+        if (sub.next(e) < 0) {
+            std::fprintf(stderr, "(publisher gone)\n");
+            if (!follow)
+                return 0;
+            continue;
+        }
+        const int64_t received_us = wall_clock_us();
+        if (last_seq != 0 && e.seq > last_seq + 1)
+            std::fprintf(stderr, "(%llu events missed)\n", (unsigned long long)(e.seq - last_seq - 1));
+        last_seq = e.seq;
+        if (!source.empty() && source != e.source)
+            continue;
+
+        const double rate = e.sample_rate ? double(e.sample_rate) : 16000.0;
+        std::printf("%s %s %.3f %.3f %.3f %s %.3f\n",
+                    event_type_name(e.type), e.source, e.sample / rate, e.length / rate,
+                    e.probability, format_wall(e.wall_us).c_str(), (received_us - e.sent_us) / 1000.0);
+        std::fflush(stdout);
+    }
+}
@@ -0,0 +1,366 @@
+#ifndef SILERO_NATIVE_H_
+#define SILERO_NATIVE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Native forward pass of the Silero VAD network (16 kHz branch), without
+// ONNX Runtime. Weights come from a .svw file written by
+// tools/extract_weights.py from silero_vad.onnx. The network, per window
+// of 512 samples plus 64 samples of context:
+//
+//   STFT     reflect pad, conv1d with the 258x256 Fourier basis (hop 128),
+//            magnitude of the 129 bins                      -> [129, 4]
+//   encoder  4 x (conv1d k=3 pad=1, ReLU):
+//            129->128 s1, 128->64 s2, 64->64 s2, 64->128 s1 -> [128, 1]
+//   decoder  LSTMCell(128, 128), ReLU, conv1d 128->1 k=1, sigmoid
+//
+// The state is the ONNX model's [2, 1, 128] tensor: h followed by c.
+// Kernels are picked at compile time: AVX-512, AVX2+FMA, or scalar.
+namespace native {
+
+// True for a weights file this engine loads (.svw) rather than an ONNX model.
+static inline bool is_weights_path(const std::string& path) {
+    return path.size() > 4 && path.compare(path.size() - 4, 4, ".svw") == 0;
+}
+
+// Vector type of the selected instruction set. VEC_LANES is 1 for the
+// scalar build.
+#if defined(__AVX512F__)
+#define VEC_LANES 16
+typedef __m512 vec_t;
+static inline vec_t vzero() { return _mm512_setzero_ps(); }
+static inline vec_t vload(const float* p) { return _mm512_loadu_ps(p); }
+static inline vec_t vfma(vec_t a, vec_t b, vec_t c) { return _mm512_fmadd_ps(a, b, c); }
+static inline float vsum(vec_t v) {
+    // Masked shuffles: the unmasked ones start from an undefined register,
+    // which GCC 12 reports as uninitialised.
+    v = _mm512_add_ps(v, _mm512_mask_shuffle_f32x4(v, 0xFFFF, v, v, 0x4E));  // swap 256-bit halves
+    v = _mm512_add_ps(v, _mm512_mask_shuffle_f32x4(v, 0xFFFF, v, v, 0xB1));  // swap 128-bit lanes
+    v = _mm512_add_ps(v, _mm512_mask_permute_ps(v, 0xFFFF, v, 0x4E));      // swap pairs
+    v = _mm512_add_ps(v, _mm512_mask_permute_ps(v, 0xFFFF, v, 0xB1));      // swap neighbours
+    return _mm512_cvtss_f32(v);
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+#define VEC_LANES 8
+typedef __m256 vec_t;
+static inline vec_t vzero() { return _mm256_setzero_ps(); }
+static inline vec_t vload(const float* p) { return _mm256_loadu_ps(p); }
+static inline vec_t vfma(vec_t a, vec_t b, vec_t c) { return _mm256_fmadd_ps(a, b, c); }
+static inline float vsum(vec_t v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+#else
+#define VEC_LANES 1
+#endif
+
+// Register block of the matrix kernels: RB rows of W against TB input
+// columns, RB * TB accumulators. Every load of W then feeds TB FMAs and
+// every load of x feeds RB, which is what keeps the small layers of this
+// network from being bound by loads. AVX2 has half the registers of
+// AVX-512, hence the narrower block.
+#if VEC_LANES == 16
+static const int kBlockCols = 4;
+#else
+static const int kBlockCols = 2;
+#endif
+static const int kBlockRows = 4;
+
+// Y[(r0 + i) * y_stride + j] = b[r0 + i] + W[r0 + i, :] . x[j] for an
+// RB x TB block; W is row-major with cols columns.
+template <int RB, int TB>
+static inline void block_kernel(const float* W, const float* b, int r0, int cols,
+                                const float* const* x, float* Y, int y_stride) {
+    float sum[RB][TB];
+    int c = 0;
+#if VEC_LANES > 1
+    vec_t acc[RB][TB];
+    for (int i = 0; i < RB; i++)
+        for (int j = 0; j < TB; j++)
+            acc[i][j] = vzero();
+    for (; c + VEC_LANES <= cols; c += VEC_LANES) {
+        vec_t xv[TB];
+        for (int j = 0; j < TB; j++)
+            xv[j] = vload(x[j] + c);
+        for (int i = 0; i < RB; i++) {
+            const vec_t w = vload(W + static_cast<size_t>(r0 + i) * cols + c);
+            for (int j = 0; j < TB; j++)
+                acc[i][j] = vfma(w, xv[j], acc[i][j]);
+        }
+    }
+    for (int i = 0; i < RB; i++)
+        for (int j = 0; j < TB; j++)
+            sum[i][j] = vsum(acc[i][j]);
+#else
+    for (int i = 0; i < RB; i++)
+        for (int j = 0; j < TB; j++)
+            sum[i][j] = 0.0f;
+#endif
+    for (; c < cols; c++)
+        for (int i = 0; i < RB; i++)
+            for (int j = 0; j < TB; j++)
+                sum[i][j] += W[static_cast<size_t>(r0 + i) * cols + c] * x[j][c];
+    for (int i = 0; i < RB; i++)
+        for (int j = 0; j < TB; j++)
+            Y[(r0 + i) * y_stride + j] = b[r0 + i] + sum[i][j];
+}
+
+// Y[r][t] = b[r] + W[r, :] . X[t] for t < n, where column t of X starts
+// at X + t * x_stride (overlapping columns are fine: the STFT frames are
+// read straight from the padded signal). Y is [rows][n]. With n == 1
+// this is a plain matrix-vector product.
+static inline void matmul(const float* W, const float* b, int rows, int cols,
+                          const float* X, int x_stride, int n, float* Y) {
+    const float* x[kBlockCols];
+    int t = 0;
+    for (; t + kBlockCols <= n; t += kBlockCols) {
+        for (int j = 0; j < kBlockCols; j++)
+            x[j] = X + static_cast<size_t>(t + j) * x_stride;
+        int r = 0;
+        for (; r + kBlockRows <= rows; r += kBlockRows)
+            block_kernel<kBlockRows, kBlockCols>(W, b, r, cols, x, Y + t, n);
+        for (; r < rows; r++)
+            block_kernel<1, kBlockCols>(W, b, r, cols, x, Y + t, n);
+    }
+    for (; t < n; t++) {
+        x[0] = X + static_cast<size_t>(t) * x_stride;
+        int r = 0;
+        for (; r + kBlockRows <= rows; r += kBlockRows)
+            block_kernel<kBlockRows, 1>(W, b, r, cols, x, Y + t, n);
+        for (; r < rows; r++)
+            block_kernel<1, 1>(W, b, r, cols, x, Y + t, n);
+    }
+}
+
+static inline float sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+// One conv1d layer (kernel 3, padding 1) followed by ReLU, run as im2col
+// plus one matmul over all output steps. Weights are [out][in][3].
+struct ConvLayer {
+    int in_ch = 0;
+    int out_ch = 0;
+    int stride = 1;
+    std::vector<float> weight;
+    std::vector<float> bias;
+
+    int out_len(int in_len) const { return (in_len + 2 - 3) / stride + 1; }
+
+    // in is [in_ch][in_len], out is [out_ch][out_len]; col is scratch of
+    // out_len * in_ch * 3.
+    void forward(const float* in, int in_len, float* out, float* col) const {
+        const int n = out_len(in_len);
+        const int width = in_ch * 3;
+        for (int t = 0; t < n; t++) {
+            const int start = t * stride - 1;
+            float* dst = col + t * width;
+            for (int c = 0; c < in_ch; c++) {
+                for (int k = 0; k < 3; k++) {
+                    const int pos = start + k;
+                    dst[c * 3 + k] = (pos >= 0 && pos < in_len) ? in[c * in_len + pos] : 0.0f;
+                }
+            }
+        }
+        matmul(weight.data(), bias.data(), out_ch, width, col, width, n, out);
+        for (int i = 0; i < out_ch * n; i++)
+            out[i] = std::max(0.0f, out[i]);
+    }
+};
+
+// SileroNet: weights plus preallocated scratch; forward() does not allocate.
+class SileroNet {
+public:
+    static const int kHidden = 128;
+
+private:
+    int sample_rate_ = 16000;
+    int filter_length = 256;
+    int hop = 128;
+    int pad_left = 0;
+    int pad_right = 64;
+    int context = 64;
+    int window = 512;
+    int bins = 129;
+
+    std::vector<float> basis;       // [2 * bins][filter_length]
+    std::vector<float> zero_bias;
+    ConvLayer enc[4];
+    std::vector<float> lstm_w;      // [4 * H][2 * H], gates i, f, g, o; columns [x, h]
+    std::vector<float> lstm_b;      // [4 * H], b_ih + b_hh
+    std::vector<float> dec_w;       // [H]
+    float dec_b = 0.0f;
+
+    // Scratch
+    std::vector<float> padded, spec, mag, buf_a, buf_b, col, xh, gates;
+
+    // Reads every tensor of a .svw file (format in tools/extract_weights.py),
+    // flattened; the layer shapes are fixed by the network.
+    static std::map<std::string, std::vector<float>> read_tensors(const std::string& path) {
+        FILE* fp = std::fopen(path.c_str(), "rb");
+        if (fp == NULL)
+            throw std::runtime_error("cannot open weights " + path);
+        std::map<std::string, std::vector<float>> tensors;
+        char magic[8];
+        uint32_t count = 0;
+        bool ok = std::fread(magic, 1, 8, fp) == 8 && std::memcmp(magic, "SILVADW1", 8) == 0 &&
+                  std::fread(&count, 4, 1, fp) == 1;
+        for (uint32_t i = 0; ok && i < count; i++) {
+            uint32_t name_len = 0, ndim = 0;
+            ok = std::fread(&name_len, 4, 1, fp) == 1 && name_len < 256;
+            std::string name(name_len, '\0');
+            ok = ok && std::fread(&name[0], 1, name_len, fp) == name_len &&
+                 std::fread(&ndim, 4, 1, fp) == 1 && ndim <= 8;
+            std::vector<uint32_t> dims(ok ? ndim : 0);
+            size_t size = 1;
+            for (uint32_t d = 0; ok && d < ndim; d++) {
+                ok = std::fread(&dims[d], 4, 1, fp) == 1;
+                size *= dims[d];
+            }
+            if (!ok)
+                break;
+            std::vector<float> data(size);
+            ok = std::fread(data.data(), sizeof(float), size, fp) == size;
+            tensors[name] = std::move(data);
+        }
+        std::fclose(fp);
+        if (!ok)
+            throw std::runtime_error("malformed weights file " + path);
+        return tensors;
+    }
+
+    static std::vector<float> take(std::map<std::string, std::vector<float>>& t, const std::string& name, size_t size) {
+        auto it = t.find(name);
+        if (it == t.end() || it->second.size() != size)
+            throw std::runtime_error("weights file lacks " + name + " of " + std::to_string(size) + " values");
+        return std::move(it->second);
+    }
+
+public:
+    // Loads a .svw weights file; throws std::runtime_error on a bad file.
+    explicit SileroNet(const std::string& path) {
+        auto t = read_tensors(path);
+        auto scalar = [&](const char* name, int fallback) {
+            auto it = t.find(name);
+            return (it != t.end() && it->second.size() == 1) ? static_cast<int>(it->second[0]) : fallback;
+        };
+        sample_rate_ = scalar("sample_rate", 16000);
+        filter_length = scalar("filter_length", 256);
+        hop = scalar("hop_length", filter_length / 2);
+        pad_left = scalar("pad_left", 0);
+        pad_right = scalar("pad_right", filter_length / 4);
+        context = scalar("context", sample_rate_ == 16000 ? 64 : 32);
+        window = scalar("window", sample_rate_ == 16000 ? 512 : 256);
+        bins = filter_length / 2 + 1;
+
+        basis = take(t, "stft.basis", static_cast<size_t>(2 * bins) * filter_length);
+        const int channels[5] = { bins, 128, 64, 64, 128 };
+        const int strides[4] = { 1, 2, 2, 1 };
+        for (int i = 0; i < 4; i++) {
+            const std::string p = "encoder." + std::to_string(i);
+            enc[i].in_ch = channels[i];
+            enc[i].out_ch = channels[i + 1];
+            enc[i].stride = strides[i];
+            enc[i].weight = take(t, p + ".weight", static_cast<size_t>(channels[i + 1]) * channels[i] * 3);
+            enc[i].bias = take(t, p + ".bias", channels[i + 1]);
+        }
+        lstm_w = take(t, "lstm.weight", static_cast<size_t>(4 * kHidden) * 2 * kHidden);
+        lstm_b = take(t, "lstm.bias", 4 * kHidden);
+        dec_w = take(t, "decoder.weight", kHidden);
+        dec_b = take(t, "decoder.bias", 1)[0];
+
+        const int input_len = context + window;
+        const int padded_len = pad_left + input_len + pad_right;
+        const int frames = (padded_len - filter_length) / hop + 1;
+        if (frames < 1 || pad_left >= input_len || pad_right >= input_len)
+            throw std::runtime_error("inconsistent STFT settings in " + path);
+        zero_bias.assign(2 * bins, 0.0f);
+        padded.assign(padded_len, 0.0f);
+        spec.assign(static_cast<size_t>(2 * bins) * frames, 0.0f);
+        mag.assign(static_cast<size_t>(bins) * frames, 0.0f);
+        buf_a.assign(static_cast<size_t>(128) * frames, 0.0f);
+        buf_b.assign(static_cast<size_t>(128) * frames, 0.0f);
+        col.assign(static_cast<size_t>(frames) * std::max(bins, 128) * 3, 0.0f);
+        xh.assign(2 * kHidden, 0.0f);
+        gates.assign(4 * kHidden, 0.0f);
+    }
+
+    int sample_rate() const { return sample_rate_; }
+    int context_samples() const { return context; }
+    int window_samples() const { return window; }
+
+    // Runs one window. input holds context + window samples; state_in and
+    // state_out are [2][128] (h, c) and may not alias. Returns the speech
+    // probability.
+    float forward(const float* input, const float* state_in, float* state_out) {
+        const int input_len = context + window;
+        const int padded_len = static_cast<int>(padded.size());
+        const int frames = (padded_len - filter_length) / hop + 1;
+
+        // Reflect padding
+        for (int i = 0; i < pad_left; i++)
+            padded[i] = input[pad_left - i];
+        std::copy(input, input + input_len, padded.begin() + pad_left);
+        for (int i = 0; i < pad_right; i++)
+            padded[pad_left + input_len + i] = input[input_len - 2 - i];
+
+        // STFT magnitude, [bins][frames]; the frames overlap in padded.
+        matmul(basis.data(), zero_bias.data(), 2 * bins, filter_length, padded.data(), hop, frames, spec.data());
+        for (int i = 0; i < bins * frames; i++) {
+            const float re = spec[i];
+            const float im = spec[bins * frames + i];
+            mag[i] = std::sqrt(re * re + im * im);
+        }
+
+        // Encoder
+        int len = frames;
+        const float* in = mag.data();
+        float* bufs[2] = { buf_a.data(), buf_b.data() };
+        for (int i = 0; i < 4; i++) {
+            float* out = bufs[i & 1];
+            enc[i].forward(in, len, out, col.data());
+            len = enc[i].out_len(len);
+            in = out;
+        }
+        // Final encoder output is [128][len]; the decoder takes the last step.
+        for (int k = 0; k < kHidden; k++)
+            xh[k] = in[k * len + (len - 1)];
+
+        // LSTMCell
+        const float* h = state_in;
+        const float* c = state_in + kHidden;
+        std::copy(h, h + kHidden, xh.begin() + kHidden);
+        matmul(lstm_w.data(), lstm_b.data(), 4 * kHidden, 2 * kHidden, xh.data(), 0, 1, gates.data());
+        float* h_out = state_out;
+        float* c_out = state_out + kHidden;
+        float logit = dec_b;
+        for (int k = 0; k < kHidden; k++) {
+            const float ig = sigmoid(gates[k]);
+            const float fg = sigmoid(gates[kHidden + k]);
+            const float gg = std::tanh(gates[2 * kHidden + k]);
+            const float og = sigmoid(gates[3 * kHidden + k]);
+            const float cn = fg * c[k] + ig * gg;
+            const float hn = og * std::tanh(cn);
+            c_out[k] = cn;
+            h_out[k] = hn;
+            logit += dec_w[k] * std::max(0.0f, hn);
+        }
+        return sigmoid(logit);
+    }
+};
+
+}  // namespace native
+
+#endif  // SILERO_NATIVE_H_
@@ -0,0 +1,240 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#define SILERO_VAD_BUILD
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+
+#include "silero_vad.h"
+#include "vad_iterator.h"
+
+// libsilerovad: the C API of silero_vad.h over VadIterator. A model owns
+// the ONNX Runtime session that its streams share (a tuned model one per
+// sample rate, as the winner depends on it); a stream runs windows
+// through its own VadIterator and feeds the probabilities to a
+// VadSegmenter, whose finished segments are handed out by pull_segments().
+
+struct silero_vad_model {
+    std::string path;
+    bool tune = false;
+    std::shared_ptr<Ort::Session> session;     // 16 kHz, or every rate untuned
+    std::mutex mutex;                          // guards session_8k
+    std::shared_ptr<Ort::Session> session_8k;  // tuned for 8 kHz on first use
+};
+
+struct silero_vad_stream {
+    std::unique_ptr<VadIterator> vad;
+    VadSegmenter segmenter;
+    int window_size = 0;
+    int pending = 0;            // samples of the window being filled
+    int64_t audio_length = 0;   // samples pushed since the start
+    bool finished = false;
+    bool keep_probs = false;
+    std::vector<float> probs;   // not pulled yet
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// Runs f, turning an exception into last_error and fail.
+template <typename F, typename R>
+R guarded(F f, R fail) {
+    try {
+        return f();
+    } catch (const std::exception& e) {
+        last_error = e.what();
+    } catch (...) {
+        last_error = "unknown error";
+    }
+    return fail;
+}
+
+void fail_with(const char* message) {
+    last_error = message;
+}
+
+// The session for streams at sample_rate; throws on failure.
+std::shared_ptr<Ort::Session> session_for(silero_vad_model* model, int sample_rate) {
+    if (!model->tune || sample_rate == 16000)
+        return model->session;
+    std::lock_guard<std::mutex> lock(model->mutex);
+    if (!model->session_8k) {
+        Ort::SessionOptions session_options;
+        model->session_8k = create_vad_session(model->path, auto_engine_config(model->path, 0, false, sample_rate),
+                                               session_options);
+    }
+    return model->session_8k;
+}
+
+// Runs the window in the stream's input buffer.
+void run_window(silero_vad_stream* s) {
+    const float prob = s->vad->infer_window();
+    s->segmenter.push(prob);
+    if (s->keep_probs)
+        s->probs.push_back(prob);
+}
+
+// Streaming input as in VadIterator::feed(): samples are converted
+// straight into the input buffer, a window at a time.
+template <typename T, typename Convert>
+int push_samples(silero_vad_stream* s, const T* samples, size_t n, Convert convert) {
+    if (s->finished) {
+        fail_with("stream already finished");
+        return -1;
+    }
+    return guarded([&] {
+        s->audio_length += static_cast<int64_t>(n);
+        while (n > 0) {
+            const size_t take = std::min(n, static_cast<size_t>(s->window_size - s->pending));
+            std::transform(samples, samples + take, s->vad->window_input() + s->pending, convert);
+            s->pending += static_cast<int>(take);
+            samples += take;
+            n -= take;
+            if (s->pending == s->window_size) {
+                run_window(s);
+                s->pending = 0;
+            }
+        }
+        return 0;
+    }, -1);
+}
+
+}  // namespace
+
+extern "C" {
+
+int silero_vad_api_version(void) {
+    return SILERO_VAD_API_VERSION;
+}
+
+const char* silero_vad_last_error(void) {
+    return last_error.c_str();
+}
+
+void silero_vad_default_params(silero_vad_params* params) {
+    params->sample_rate = 16000;
+    params->threshold = 0.5f;
+    params->min_silence_ms = 100;
+    params->speech_pad_ms = 30;
+    params->min_speech_ms = 250;
+    params->max_speech_s = 0.0f;
+}
+
+silero_vad_model* silero_vad_model_create(const char* model_path, int tune) {
+    return guarded([&] {
+        auto model = std::make_unique<silero_vad_model>();
+        model->path = model_path ? model_path : MODEL_PATH;
+        model->tune = tune != 0;
+        Ort::SessionOptions session_options;
+        model->session = create_vad_session(model->path, tune ? auto_engine_config(model->path) : EngineConfig(),
+                                            session_options);
+        return model.release();
+    }, static_cast<silero_vad_model*>(nullptr));
+}
+
+void silero_vad_model_destroy(silero_vad_model* model) {
+    delete model;
+}
+
+silero_vad_stream* silero_vad_stream_create(silero_vad_model* model, const silero_vad_params* params) {
+    silero_vad_params p;
+    silero_vad_default_params(&p);
+    if (params)
+        p = *params;
+    if (!model) {
+        fail_with("no model");
+        return nullptr;
+    }
+    if (p.sample_rate != 16000 && p.sample_rate != 8000) {
+        fail_with("unsupported sample rate (16000 or 8000)");
+        return nullptr;
+    }
+    return guarded([&] {
+        const float max_speech_s = p.max_speech_s > 0.0f ? p.max_speech_s : std::numeric_limits<float>::infinity();
+        auto s = std::make_unique<silero_vad_stream>();
+        s->vad = std::make_unique<VadIterator>(session_for(model, p.sample_rate), p.sample_rate, 32, p.threshold,
+            p.min_silence_ms, p.speech_pad_ms, p.min_speech_ms, max_speech_s);
+        s->segmenter = VadSegmenter(p.sample_rate, 32, p.threshold, p.min_silence_ms,
+            p.speech_pad_ms, p.min_speech_ms, max_speech_s);
+        s->window_size = s->vad->window_size();
+        return s.release();
+    }, static_cast<silero_vad_stream*>(nullptr));
+}
+
+void silero_vad_stream_destroy(silero_vad_stream* stream) {
+    delete stream;
+}
+
+int silero_vad_stream_window_size(const silero_vad_stream* stream) {
+    return stream->window_size;
+}
+
+int silero_vad_stream_push(silero_vad_stream* stream, const float* samples, size_t n) {
+    return push_samples(stream, samples, n, [](float x) { return x; });
+}
+
+int silero_vad_stream_push_pcm16(silero_vad_stream* stream, const int16_t* samples, size_t n) {
+    return push_samples(stream, samples, n, [](int16_t x) { return x / 32768.0f; });
+}
+
+int silero_vad_stream_finish(silero_vad_stream* stream) {
+    if (stream->finished) {
+        fail_with("stream already finished");
+        return -1;
+    }
+    stream->segmenter.finish(stream->audio_length);
+    stream->finished = true;
+    return 0;
+}
+
+void silero_vad_stream_reset(silero_vad_stream* stream) {
+    stream->vad->reset();
+    stream->segmenter.reset();
+    stream->pending = 0;
+    stream->audio_length = 0;
+    stream->finished = false;
+    stream->probs.clear();
+}
+
+size_t silero_vad_stream_pull_segments(silero_vad_stream* stream, silero_vad_segment* out, size_t max) {
+    const std::vector<timestamp_t>& speeches = stream->segmenter.get_speech_timestamps();
+    const size_t n = std::min(max, speeches.size());
+    for (size_t i = 0; i < n; i++) {
+        out[i].start = speeches[i].start;
+        out[i].end = speeches[i].end;
+    }
+    stream->segmenter.drop_speeches(n);
+    return n;
+}
+
+size_t silero_vad_stream_pull_probs(silero_vad_stream* stream, float* out, size_t max) {
+    const size_t n = std::min(max, stream->probs.size());
+    std::copy(stream->probs.begin(), stream->probs.begin() + n, out);
+    stream->probs.erase(stream->probs.begin(), stream->probs.begin() + n);
+    return n;
+}
+
+void silero_vad_stream_keep_probs(silero_vad_stream* stream, int keep) {
+    stream->keep_probs = keep != 0;
+    if (!stream->keep_probs)
+        stream->probs.clear();
+}
+
+int silero_vad_stream_in_speech(const silero_vad_stream* stream) {
+    return stream->segmenter.is_triggered() ? 1 : 0;
+}
+
+int64_t silero_vad_stream_speech_start(const silero_vad_stream* stream) {
+    return stream->segmenter.get_current_start();
+}
+
+}  // extern "C"
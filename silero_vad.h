@@ -0,0 +1,129 @@
+#ifndef SILERO_VAD_H_
+#define SILERO_VAD_H_
+
+// C API of libsilerovad: Silero VAD in-process, for programs that would
+// otherwise run `vad` and parse its output.
+//
+//   silero_vad_model* model = silero_vad_model_create(NULL, 0);
+//   silero_vad_params params;
+//   silero_vad_default_params(&params);
+//   silero_vad_stream* stream = silero_vad_stream_create(model, &params);
+//
+//   while (more audio)
+//       silero_vad_stream_push(stream, samples, n);        // any block size
+//       while (silero_vad_stream_pull_segments(stream, segs, 16) > 0) ...
+//   silero_vad_stream_finish(stream);                    // closes an open segment
+//   ... pull the last segments ...
+//
+//   silero_vad_stream_destroy(stream);
+//   silero_vad_model_destroy(model);
+//
+// A model is loaded once and shared by all of its streams; streams of one
+// model may be used from different threads at the same time, but each
+// stream from one thread at a time. Functions that fail return NULL or a
+// negative value, and silero_vad_last_error() describes the failure on the
+// calling thread. No function lets a C++ exception escape.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(SILERO_VAD_BUILD)
+#    define SILERO_VAD_API __declspec(dllexport)
+#  else
+#    define SILERO_VAD_API __declspec(dllimport)
+#  endif
+#else
+#  define SILERO_VAD_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bumped on incompatible changes to this header.
+#define SILERO_VAD_API_VERSION 1
+
+typedef struct silero_vad_model silero_vad_model;
+typedef struct silero_vad_stream silero_vad_stream;
+
+// Segmentation settings of a stream, with the same meaning as vad's.
+typedef struct silero_vad_params {
+    int sample_rate;        // of the pushed samples; 16000 or 8000
+    float threshold;        // speech probability that opens a segment
+    int min_silence_ms;     // silence that closes a segment
+    int speech_pad_ms;
+    int min_speech_ms;      // shorter segments are dropped
+    float max_speech_s;     // longer segments are split; 0 = no limit
+} silero_vad_params;
+
+// A finished speech segment, in samples from the start of the stream.
+// Positions are counted in 64 bits throughout, so a stream can be fed
+// for as long as the process runs.
+typedef struct silero_vad_segment {
+    int64_t start;
+    int64_t end;
+} silero_vad_segment;
+
+SILERO_VAD_API int silero_vad_api_version(void);
+
+// Message of the last failure on this thread ("" if none).
+SILERO_VAD_API const char* silero_vad_last_error(void);
+
+// Fills params with vad's defaults.
+SILERO_VAD_API void silero_vad_default_params(silero_vad_params* params);
+
+// Loads an ONNX model; NULL uses the installed model. With tune != 0 the
+// ONNX Runtime threading is tuned for this machine on first use and
+// cached, as `vad --tune` does: for 16 kHz here, and for 8 kHz when the
+// first 8 kHz stream is created.
+SILERO_VAD_API silero_vad_model* silero_vad_model_create(const char* model_path, int tune);
+SILERO_VAD_API void silero_vad_model_destroy(silero_vad_model* model);
+
+// A new stream on model; params NULL uses the defaults. Streams must be
+// destroyed before their model.
+SILERO_VAD_API silero_vad_stream* silero_vad_stream_create(silero_vad_model* model,
+                                                          const silero_vad_params* params);
+SILERO_VAD_API void silero_vad_stream_destroy(silero_vad_stream* stream);
+
+// Number of samples per inference window (512 at 16 kHz, 256 at 8 kHz):
+// segments and probabilities advance in steps of this size.
+SILERO_VAD_API int silero_vad_stream_window_size(const silero_vad_stream* stream);
+
+// Pushes the next n mono samples, floats in [-1, 1] or 16-bit PCM. Whole
+// windows are run as soon as they are complete. Returns 0, or -1 after
+// finish() or on an inference error.
+SILERO_VAD_API int silero_vad_stream_push(silero_vad_stream* stream, const float* samples, size_t n);
+SILERO_VAD_API int silero_vad_stream_push_pcm16(silero_vad_stream* stream, const int16_t* samples, size_t n);
+
+// Ends the stream: a trailing partial window is dropped and a segment
+// still open is closed at the last sample. Returns 0, or -1 if already
+// finished.
+SILERO_VAD_API int silero_vad_stream_finish(silero_vad_stream* stream);
+
+// Starts the stream over at sample 0, dropping anything not pulled yet.
+SILERO_VAD_API void silero_vad_stream_reset(silero_vad_stream* stream);
+
+// Moves up to max finished segments, oldest first, into out and returns
+// how many were moved.
+SILERO_VAD_API size_t silero_vad_stream_pull_segments(silero_vad_stream* stream,
+                                                     silero_vad_segment* out, size_t max);
+
+// Moves up to max speech probabilities, one per window in order, into out
+// and returns how many were moved. Probabilities are only queued after
+// silero_vad_stream_keep_probs(stream, 1).
+SILERO_VAD_API size_t silero_vad_stream_pull_probs(silero_vad_stream* stream, float* out, size_t max);
+
+// Whether the stream queues per-window probabilities for pull_probs();
+// off by default, so a stream that never pulls them does not grow.
+SILERO_VAD_API void silero_vad_stream_keep_probs(silero_vad_stream* stream, int keep);
+
+// Whether a segment is open, and where it started (-1 if none).
+SILERO_VAD_API int silero_vad_stream_in_speech(const silero_vad_stream* stream);
+SILERO_VAD_API int64_t silero_vad_stream_speech_start(const silero_vad_stream* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SILERO_VAD_H_
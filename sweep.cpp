@@ -0,0 +1,574 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <climits>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+
+#include "prob_track.h"
+#include "thread_pool.h"
+
+// Segmentation parameter sweep over stored probability tracks (.vadp,
+// written by `vad --save-probs`). Every combination of the value lists
+// given for threshold, min_silence_ms, min_speech_ms, max_speech_s and
+// speech_pad_ms is segmented over the whole corpus, and one JSON object per
+// combination is printed to stdout:
+//
+//   {"threshold":0.5,"min_silence_ms":100,...,"segments":412,"speech_ratio":0.3817,...}
+//
+// With --labels=DIR, DIR/<name>.txt holds the reference speech of
+// <name>.vadp, and every line also has window-level agreement, precision,
+// recall and F1 against it, pooled over the corpus.
+//
+// The model is not run: a combination costs one pass of the VadSegmenter
+// state machine over the probabilities. SegmenterLanes runs that state
+// machine for LANES combinations side by side, branch-free, so each window
+// updates all of them with a few vector instructions; blocks of lanes and
+// tracks are spread over all cores. Segment boundaries are exactly those
+// `vad --resegment` prints for the same options (--verify checks this).
+
+// One point of the grid, in the units of vad's options.
+struct SweepParams {
+    float threshold = 0.5f;
+    int min_silence_ms = 100;
+    int min_speech_ms = 250;
+    float max_speech_s = 0.0f;   // 0 = no limit
+    int speech_pad_ms = 30;
+
+    VadSegmenter segmenter(int sample_rate, int window_ms) const {
+        return VadSegmenter(sample_rate, window_ms, threshold, min_silence_ms, speech_pad_ms, min_speech_ms,
+                            max_speech_s > 0.0f ? max_speech_s : std::numeric_limits<float>::infinity());
+    }
+};
+
+// A loaded track and its reference labels as a prefix sum over windows:
+// ref[w] is the number of speech windows before window w (empty without
+// --labels).
+struct SweepTrack {
+    std::string path;
+    ProbTrack track;
+    std::vector<int32_t> ref;
+};
+
+// What a combination produced over one track (or, summed, the corpus).
+struct SweepTotals {
+    int64_t segments = 0;
+    int64_t speech_samples = 0;
+    int64_t speech_windows = 0;   // windows inside a segment
+    int64_t hit_windows = 0;      // of those, windows labelled speech
+
+    void add(const SweepTotals& o) {
+        segments += o.segments;
+        speech_samples += o.speech_samples;
+        speech_windows += o.speech_windows;
+        hit_windows += o.hit_windows;
+    }
+};
+
+static const int LANES = 16;
+
+static int floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0)))
+        q--;
+    return static_cast<int>(std::max<int64_t>(INT_MIN, std::min<int64_t>(INT_MAX, q)));
+}
+
+// VadSegmenter::push() for LANES parameter sets at once. All positions are
+// kept in windows, which is exact: the state machine only ever stores
+// multiples of the window size, so each sample threshold becomes the
+// window count that crosses it. A lane's segment is open while
+// cur_start >= 0 (VadSegmenter's `triggered`); temp_end == 0 means unset,
+// as there.
+class SegmenterLanes {
+private:
+    // Per-lane thresholds, precomputed for the track's window size.
+    alignas(64) float high[LANES];        // p >= high: speech
+    alignas(64) float low[LANES];         // p < low: silence (threshold - 0.15)
+    alignas(64) int32_t max_speech[LANES];    // split once longer than this
+    alignas(64) int32_t min_silence[LANES];   // close after this much silence
+    alignas(64) int32_t min_speech[LANES];    // keep only segments longer than this
+    int32_t silence_at_max_speech;
+
+    // State, as in VadSegmenter.
+    alignas(64) int32_t cur_start[LANES];
+    alignas(64) int32_t temp_end[LANES];
+    alignas(64) int32_t prev_end[LANES];
+    alignas(64) int32_t next_start[LANES];
+    int32_t current = 0;
+
+    // Emitted segments.
+    alignas(64) int32_t segments[LANES];
+    alignas(64) int32_t speech_windows[LANES];
+    alignas(64) int32_t hit_windows[LANES];
+    alignas(64) int32_t emit_start[LANES];   // of the last push()
+    alignas(64) int32_t emit_end[LANES];
+
+    int window;
+
+public:
+    // Lanes past num_lanes repeat the last set and are ignored.
+    SegmenterLanes(const SweepParams* params, int num_lanes, int sample_rate, int window_samples)
+        : window(window_samples)
+    {
+        const int sr_per_ms = sample_rate / 1000;
+        silence_at_max_speech = floor_div(sr_per_ms * 98, window);
+        for (int l = 0; l < LANES; l++) {
+            const SweepParams& p = params[std::min(l, num_lanes - 1)];
+            high[l] = p.threshold;
+            // The smallest float not below threshold - 0.15 (a double in
+            // VadSegmenter), so that p < low[l] decides exactly as there.
+            const double low_d = p.threshold - 0.15;
+            float f = static_cast<float>(low_d);
+            if (static_cast<double>(f) < low_d)
+                f = std::nextafter(f, std::numeric_limits<float>::infinity());
+            low[l] = f;
+
+            // x windows of silence close a segment once x * window >= min_silence.
+            const int64_t silence = static_cast<int64_t>(sr_per_ms) * p.min_silence_ms;
+            min_silence[l] = -floor_div(-silence, window);
+            min_speech[l] = floor_div(static_cast<int64_t>(sr_per_ms) * p.min_speech_ms, window);
+
+            // Longest segment in windows: the smallest x with x * window
+            // above VadSegmenter's max_speech_samples (a float, computed
+            // the same way), less one.
+            const float max_s = p.max_speech_s > 0.0f ? p.max_speech_s : std::numeric_limits<float>::infinity();
+            const float limit = sample_rate * max_s - window - 2 * p.speech_pad_ms;
+            if (!(limit < static_cast<float>(INT_MAX / 2))) {
+                max_speech[l] = INT_MAX;
+            } else {
+                int64_t x = std::max<int64_t>(0, static_cast<int64_t>(std::floor(limit / window)) - 1);
+                while (!(static_cast<float>(x * window) > limit))
+                    x++;
+                max_speech[l] = static_cast<int32_t>(x - 1);
+            }
+        }
+        reset();
+    }
+
+    void reset() {
+        current = 0;
+        for (int l = 0; l < LANES; l++) {
+            cur_start[l] = -1;
+            temp_end[l] = prev_end[l] = next_start[l] = 0;
+            segments[l] = speech_windows[l] = hit_windows[l] = 0;
+            emit_start[l] = emit_end[l] = 0;
+        }
+    }
+
+    // Advances every lane by one window. ref is the label prefix sum of
+    // the track (see SweepTrack), used when labelled.
+    template <bool labelled>
+    void push(float p, const int32_t* ref) {
+        const int32_t cs = ++current;
+        int32_t any_emit = 0;
+        // Every condition is evaluated for every lane (0/1 masks
+        // combined with & and |, selects rather than ifs) so the loop vectorizes.
+        for (int l = 0; l < LANES; l++) {
+            const int32_t start = cur_start[l];
+            const int32_t te_in = temp_end[l];
+            const int32_t pe_in = prev_end[l];
+            const int32_t ns_in = next_start[l];
+            const int32_t open = start >= 0;
+            const int32_t speech = p >= high[l];
+            const int32_t too_long = (speech ^ 1) & open & ((cs - start) > max_speech[l]);
+            const int32_t silence = (speech ^ 1) & (too_long ^ 1) & open & (p < low[l]);
+
+            // Speech: cancel a pending end, open a segment.
+            const int32_t resumed = speech & (te_in != 0) & (ns_in < pe_in);
+            const int32_t ns = resumed ? cs - 1 : ns_in;
+            const int32_t cur = (speech & (open ^ 1)) ? cs - 1 : start;
+
+            // Silence: note where it began; close once long enough.
+            const int32_t silent_from = te_in == 0 ? cs : te_in;
+            const int32_t te = speech ? 0 : (silence ? silent_from : te_in);
+            const int32_t pe = (silence & ((cs - silent_from) > silence_at_max_speech)) ? silent_from : pe_in;
+            const int32_t closed = silence & ((cs - silent_from) >= min_silence[l]) &
+                                ((silent_from - start) > min_speech[l]);
+
+            // Too long: split at the last long pause, or right here.
+            const int32_t split_at_pause = too_long & (pe_in > 0);
+            const int32_t reopen = split_at_pause & (ns_in >= pe_in);
+
+            const int32_t emit = too_long | closed;
+            const int32_t end = closed ? silent_from : (split_at_pause ? pe_in : cs);
+            segments[l] += emit;
+            speech_windows[l] += emit ? end - start : 0;
+            emit_start[l] = start & -emit;   // 0 where nothing is emitted
+            emit_end[l] = end & -emit;
+            any_emit |= emit;
+
+            cur_start[l] = emit ? (reopen ? ns_in : -1) : cur;
+            temp_end[l] = emit ? 0 : te;
+            prev_end[l] = emit ? 0 : pe;
+            next_start[l] = emit ? 0 : ns;
+        }
+
+        // Segments end rarely, so their label overlap is looked up here
+        // rather than gathered in the loop above.
+        if (labelled && any_emit) {
+            for (int l = 0; l < LANES; l++)
+                hit_windows[l] += ref[emit_end[l]] - ref[emit_start[l]];
+        }
+    }
+
+    // VadSegmenter::finish(): an open segment runs to the end of the audio.
+    // Returns the totals of lane l.
+    SweepTotals finish(int l, int64_t audio_samples, const int32_t* ref) const {
+        SweepTotals t;
+        t.segments = segments[l];
+        t.speech_windows = speech_windows[l];
+        t.speech_samples = static_cast<int64_t>(speech_windows[l]) * window;
+        t.hit_windows = hit_windows[l];
+        if (cur_start[l] >= 0) {
+            t.segments++;
+            t.speech_windows += current - cur_start[l];
+            t.speech_samples += audio_samples - static_cast<int64_t>(cur_start[l]) * window;
+            if (ref)
+                t.hit_windows += ref[current] - ref[cur_start[l]];
+        }
+        return t;
+    }
+};
+
+// Parses a comma separated list of values and FROM:TO:STEP ranges, e.g.
+// "0.3:0.7:0.05" or "100,200,500". Returns false on a malformed item.
+static bool parse_values(const std::string& s, std::vector<double>& out) {
+    out.clear();
+    std::stringstream in(s);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        double from, to, step;
+        char tail;
+        if (std::sscanf(item.c_str(), "%lf:%lf:%lf%c", &from, &to, &step, &tail) == 3) {
+            if (!(step > 0.0) || to < from)
+                return false;
+            const long n = std::lround(std::floor((to - from) / step + 1e-9));
+            for (long k = 0; k <= n; k++)
+                out.push_back(std::round((from + k * step) * 1e6) / 1e6);
+        } else if (std::sscanf(item.c_str(), "%lf%c", &from, &tail) == 1) {
+            out.push_back(from);
+        } else {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+// Reads the reference speech of a track: one segment per line, as
+// "<start> <end>" or "<start> to <end>" seconds (Audacity labels, `vad
+// --chunk` output) or `vad` output lines. '#' lines are skipped. A window
+// counts as speech when its centre is inside a segment; the result is the
+// prefix sum described at SweepTrack.
+static bool load_labels(const std::string& path, const ProbTrack& track, std::vector<int32_t>& ref) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Error: cannot open labels: " << path << "\n";
+        return false;
+    }
+    const size_t n = track.probs.size();
+    std::vector<uint8_t> speech(n, 0);
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+            continue;
+        double start, end;
+        if (std::sscanf(line.c_str(), "Speech detected from %lf s to %lf s", &start, &end) != 2 &&
+            std::sscanf(line.c_str(), "%lf to %lf", &start, &end) != 2 &&
+            std::sscanf(line.c_str(), "%lf %lf", &start, &end) != 2) {
+            std::cerr << "Error: " << path << ":" << line_no << ": not a segment\n";
+            return false;
+        }
+        // Windows whose centre (w + 0.5) * window lies in [start, end).
+        const double first = start * track.sample_rate / track.window_samples - 0.5;
+        const double last = end * track.sample_rate / track.window_samples - 0.5;
+        const size_t w0 = static_cast<size_t>(std::max(0.0, std::ceil(first)));
+        const size_t w1 = static_cast<size_t>(std::max(0.0, std::min(static_cast<double>(n), std::ceil(last))));
+        for (size_t w = w0; w < w1; w++)
+            speech[w] = 1;
+    }
+    ref.assign(n + 1, 0);
+    for (size_t w = 0; w < n; w++)
+        ref[w + 1] = ref[w] + speech[w];
+    return true;
+}
+
+// Runs block's parameter sets over one track.
+static void sweep_track(const SweepTrack& t, const SweepParams* params, int num_lanes, SweepTotals* out) {
+    SegmenterLanes lanes(params, num_lanes, t.track.sample_rate, t.track.window_samples);
+    const int32_t* ref = t.ref.empty() ? nullptr : t.ref.data();
+    if (ref) {
+        for (float p : t.track.probs)
+            lanes.push<true>(p, ref);
+    } else {
+        for (float p : t.track.probs)
+            lanes.push<false>(p, ref);
+    }
+    for (int l = 0; l < num_lanes; l++)
+        out[l] = lanes.finish(l, static_cast<int64_t>(t.track.audio_samples), ref);
+}
+
+// Runs params through VadSegmenter itself, as `vad --resegment` does, and
+// returns the number of combinations whose totals differ from totals.
+static size_t verify(const std::vector<SweepTrack>& tracks, const std::vector<SweepParams>& params,
+                     const std::vector<SweepTotals>& totals) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < params.size(); i++) {
+        SweepTotals expect;
+        for (const SweepTrack& t : tracks) {
+            VadSegmenter segmenter = params[i].segmenter(t.track.sample_rate,
+                                                         t.track.window_samples * 1000 / t.track.sample_rate);
+            for (const timestamp_t& s : t.track.segment(segmenter)) {
+                expect.segments++;
+                expect.speech_samples += s.end - s.start;
+            }
+        }
+        if (expect.segments != totals[i].segments || expect.speech_samples != totals[i].speech_samples) {
+            if (mismatches++ < 10)
+                std::cerr << "MISMATCH set " << i << ": " << totals[i].segments << " segments, "
+                          << totals[i].speech_samples << " samples vs " << expect.segments << ", "
+                          << expect.speech_samples << " from VadSegmenter\n";
+        }
+    }
+    return mismatches;
+}
+
+// Whether path ends in ext (lower case, e.g. ".vadp"), ignoring case.
+static bool has_extension(const std::string& path, const std::string& ext) {
+    if (path.size() < ext.size())
+        return false;
+    std::string tail = path.substr(path.size() - ext.size());
+    std::transform(tail.begin(), tail.end(), tail.begin(), ::tolower);
+    return tail == ext;
+}
+
+// Expands a CLI path: a directory contributes its .vadp files (sorted).
+static void add_input_path(const std::string& path, std::vector<std::string>& track_paths) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec)) {
+        track_paths.push_back(path);
+        return;
+    }
+    std::vector<std::string> found;
+    for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+        if (entry.is_regular_file(ec) && has_extension(entry.path().string(), ".vadp"))
+            found.push_back(entry.path().string());
+    }
+    std::sort(found.begin(), found.end());
+    track_paths.insert(track_paths.end(), found.begin(), found.end());
+}
+
+static void usage() {
+    std::cerr << "Usage: ./vad_sweep [options] <track.vadp|dir> [more ...]\n"
+              << "  Value lists are comma separated numbers or FROM:TO:STEP ranges.\n"
+              << "  --threshold=LIST      speech probability that opens a segment (default: 0.5)\n"
+              << "  --min-silence-ms=LIST silence that closes a segment (default: 100)\n"
+              << "  --min-speech-ms=LIST  shortest segment kept (default: 250)\n"
+              << "  --max-speech-s=LIST   split segments longer than S, 0 = no limit (default: 0)\n"
+              << "  --speech-pad-ms=LIST  padding reserved within max-speech-s (default: 30)\n"
+              << "  --labels=DIR          reference speech of <name>.vadp in DIR/<name>.txt\n"
+              << "  --top=N               print only the N sets with the best F1 (needs --labels)\n"
+              << "  -j N, --jobs=N        worker threads (default: all cores)\n"
+              << "  --verify              also run every set through VadSegmenter and compare\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<double> thresholds = { 0.5 };
+    std::vector<double> min_silences = { 100 };
+    std::vector<double> min_speeches = { 250 };
+    std::vector<double> max_speeches = { 0 };
+    std::vector<double> speech_pads = { 30 };
+    std::string labels_dir;
+    size_t top = 0;
+    int jobs = 0;
+    bool check = false;
+    std::vector<std::string> track_paths;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool ok = true;
+        if (a == "-h" || a == "--help") {
+            usage();
+            return 0;
+        } else if (a.rfind("--threshold=", 0) == 0) {
+            ok = parse_values(a.substr(12), thresholds);
+        } else if (a.rfind("--min-silence-ms=", 0) == 0) {
+            ok = parse_values(a.substr(17), min_silences);
+        } else if (a.rfind("--min-speech-ms=", 0) == 0) {
+            ok = parse_values(a.substr(16), min_speeches);
+        } else if (a.rfind("--max-speech-s=", 0) == 0) {
+            ok = parse_values(a.substr(15), max_speeches);
+        } else if (a.rfind("--speech-pad-ms=", 0) == 0) {
+            ok = parse_values(a.substr(16), speech_pads);
+        } else if (a.rfind("--labels=", 0) == 0) {
+            labels_dir = a.substr(9);
+        } else if (a.rfind("--top=", 0) == 0) {
+            top = static_cast<size_t>(std::max(0, std::atoi(a.c_str() + 6)));
+        } else if (a == "-j" && i + 1 < argc) {
+            jobs = std::atoi(argv[++i]);
+        } else if (a.rfind("--jobs=", 0) == 0) {
+            jobs = std::atoi(a.c_str() + 7);
+        } else if (a == "--verify") {
+            check = true;
+        } else if (a.rfind("--", 0) == 0) {
+            std::cerr << "Unknown arg: " << a << "\n";
+            usage();
+            return 1;
+        } else {
+            add_input_path(a, track_paths);
+        }
+        if (!ok) {
+            std::cerr << "Error: bad value list: " << a << "\n";
+            return 1;
+        }
+    }
+    if (track_paths.empty()) {
+        usage();
+        return 1;
+    }
+    if (top > 0 && labels_dir.empty()) {
+        std::cerr << "Error: --top ranks by F1 and needs --labels\n";
+        return 1;
+    }
+
+    std::vector<SweepParams> params;
+    for (double th : thresholds)
+        for (double sil : min_silences)
+            for (double sp : min_speeches)
+                for (double mx : max_speeches)
+                    for (double pad : speech_pads) {
+                        SweepParams p;
+                        p.threshold = static_cast<float>(th);
+                        p.min_silence_ms = std::max(0, static_cast<int>(std::lround(sil)));
+                        p.min_speech_ms = std::max(0, static_cast<int>(std::lround(sp)));
+                        p.max_speech_s = static_cast<float>(std::max(0.0, mx));
+                        p.speech_pad_ms = std::max(0, static_cast<int>(std::lround(pad)));
+                        params.push_back(p);
+                    }
+
+    std::vector<SweepTrack> tracks(track_paths.size());
+    double audio_s = 0.0;
+    for (size_t i = 0; i < tracks.size(); i++) {
+        SweepTrack& t = tracks[i];
+        t.path = track_paths[i];
+        try {
+            t.track.load(t.path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        if (t.track.sample_rate < 1000 || t.track.window_samples % (t.track.sample_rate / 1000) != 0 ||
+            t.track.probs.size() >= static_cast<size_t>(INT_MAX)) {
+            std::cerr << "Error: unsupported probability track " << t.path << "\n";
+            return 1;
+        }
+        if (!labels_dir.empty()) {
+            std::filesystem::path label_path = std::filesystem::path(labels_dir) /
+                (std::filesystem::path(t.path).stem().string() + ".txt");
+            if (!load_labels(label_path.string(), t.track, t.ref))
+                return 1;
+        }
+        audio_s += static_cast<double>(t.track.audio_samples) / t.track.sample_rate;
+    }
+
+    // One task per (block of LANES sets, track), longest tracks first.
+    std::vector<size_t> order(tracks.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return tracks[a].track.probs.size() > tracks[b].track.probs.size();
+    });
+    const size_t num_blocks = (params.size() + LANES - 1) / LANES;
+    std::vector<SweepTotals> per_task(num_blocks * tracks.size() * LANES);
+
+    WorkStealingPool pool(jobs > 0 ? jobs : static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    auto start = std::chrono::steady_clock::now();
+    pool.run(num_blocks * tracks.size(), [&](size_t task, int) {
+        const size_t block = task % num_blocks;
+        const size_t first = block * LANES;
+        const int num_lanes = static_cast<int>(std::min<size_t>(LANES, params.size() - first));
+        sweep_track(tracks[order[task / num_blocks]], &params[first], num_lanes, &per_task[task * LANES]);
+    });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<SweepTotals> totals(params.size());
+    for (size_t task = 0; task < num_blocks * tracks.size(); task++) {
+        const size_t first = (task % num_blocks) * LANES;
+        for (size_t l = 0; l < LANES && first + l < params.size(); l++)
+            totals[first + l].add(per_task[task * LANES + l]);
+    }
+
+    int64_t windows = 0, ref_windows = 0, audio_samples = 0;
+    for (const SweepTrack& t : tracks) {
+        windows += static_cast<int64_t>(t.track.probs.size());
+        audio_samples += static_cast<int64_t>(t.track.audio_samples);
+        if (!t.ref.empty())
+            ref_windows += t.ref.back();
+    }
+    const bool labelled = !labels_dir.empty();
+    auto f1 = [&](const SweepTotals& t) {
+        const int64_t d = t.speech_windows + ref_windows;
+        return d > 0 ? 2.0 * t.hit_windows / d : 1.0;
+    };
+
+    std::vector<size_t> rows(params.size());
+    for (size_t i = 0; i < rows.size(); i++)
+        rows[i] = i;
+    if (top > 0) {
+        std::stable_sort(rows.begin(), rows.end(), [&](size_t a, size_t b) {
+            return f1(totals[a]) > f1(totals[b]);
+        });
+        rows.resize(std::min(top, rows.size()));
+    }
+    for (size_t i : rows) {
+        const SweepParams& p = params[i];
+        const SweepTotals& t = totals[i];
+        std::ostringstream line;
+        line << "{\"threshold\":" << p.threshold
+             << ",\"min_silence_ms\":" << p.min_silence_ms
+             << ",\"min_speech_ms\":" << p.min_speech_ms
+             << ",\"max_speech_s\":" << p.max_speech_s
+             << ",\"speech_pad_ms\":" << p.speech_pad_ms
+             << ",\"segments\":" << t.segments
+             << std::fixed << std::setprecision(4)
+             << ",\"speech_ratio\":" << (audio_samples > 0 ? static_cast<double>(t.speech_samples) / audio_samples : 0.0);
+        if (labelled) {
+            const int64_t tn = windows - t.speech_windows - ref_windows + t.hit_windows;
+            line << ",\"agreement\":" << (windows > 0 ? static_cast<double>(t.hit_windows + tn) / windows : 1.0)
+                 << ",\"precision\":" << (t.speech_windows > 0 ? static_cast<double>(t.hit_windows) / t.speech_windows : 1.0)
+                 << ",\"recall\":" << (ref_windows > 0 ? static_cast<double>(t.hit_windows) / ref_windows : 1.0)
+                 << ",\"f1\":" << f1(t);
+        }
+        line << "}";
+        std::cout << line.str() << "\n";
+    }
+    std::cout.flush();
+
+    std::cerr << "Swept " << params.size() << " parameter sets over " << tracks.size() << " tracks ("
+              << std::fixed << std::setprecision(1) << audio_s / 3600.0 << " h of audio) in "
+              << std::setprecision(3) << elapsed << " s on " << pool.workers() << " worker(s)\n";
+
+    if (check) {
+        const size_t mismatches = verify(tracks, params, totals);
+        std::cerr << "Verified against VadSegmenter: " << (params.size() - mismatches) << "/" << params.size()
+                  << " sets match\n";
+        if (mismatches != 0)
+            return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// WorkStealingPool: runs a fixed set of indexed tasks on N worker threads.
+// Tasks are dealt round-robin into per-worker deques; a worker takes from
+// the front of its own deque and, once it is empty, steals from the back
+// of the others. Long and short tasks therefore even out without a shared
+// queue being hit on every task.
+class WorkStealingPool {
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    int num_workers;
+    std::vector<WorkerQueue> queues;
+
+    bool pop_own(int w, size_t& task) {
+        std::lock_guard<std::mutex> lock(queues[w].mutex);
+        if (queues[w].tasks.empty())
+            return false;
+        task = queues[w].tasks.front();
+        queues[w].tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int w, size_t& task) {
+        for (int k = 1; k < num_workers; k++) {
+            WorkerQueue& victim = queues[(w + k) % num_workers];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty())
+                continue;
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingPool(int workers)
+        : num_workers(std::max(1, workers)), queues(num_workers) { }
+
+    int workers() const { return num_workers; }
+
+    // Runs fn(task, worker) for every task in [0, num_tasks) and returns
+    // when all of them are done. Tasks are dealt in index order, so callers
+    // that sort their work longest-first get the best balance.
+    void run(size_t num_tasks, const std::function<void(size_t, int)>& fn) {
+        for (size_t t = 0; t < num_tasks; t++)
+            queues[t % num_workers].tasks.push_back(t);
+
+        std::vector<std::thread> threads;
+        for (int w = 0; w < num_workers; w++) {
+            threads.emplace_back([this, w, &fn]() {
+                size_t task;
+                while (pop_own(w, task) || steal(w, task))
+                    fn(task, w);
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+    }
+};
+
+#endif  // THREAD_POOL_H_
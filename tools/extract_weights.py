@@ -0,0 +1,492 @@
+#!/usr/bin/env python3
+"""Extracts the 16 kHz Silero VAD weights from silero_vad.onnx into a .svw
+file for the native engine (silero_native.h).
+
+    python3 tools/extract_weights.py silero_vad.onnx silero_vad.svw [--verify]
+
+The ONNX file is read with a small protobuf decoder, so only numpy is
+needed. The 16 kHz branch is the subgraph whose STFT convolution has a
+256-sample kernel; its weights are taken in graph order:
+
+    stft.basis          [258, 256]   Fourier basis of the STFT conv
+    encoder.{0..3}      conv k=3 weights [out, in, 3] and biases [out]
+    lstm.weight         [512, 256]   gates i, f, g, o; columns [x, h]
+    lstm.bias           [512]        input plus recurrent bias
+    decoder.weight      [128]        1x1 conv to the speech logit
+    decoder.bias        [1]
+
+plus the STFT padding read from the graph's Pad node. ONNX LSTM weights
+(gates i, o, f, c) are reordered to the i, f, g, o layout the engine uses.
+
+--verify runs random windows through both the ONNX model (with the
+onnxruntime Python package) and a numpy copy of the native forward pass,
+carrying the state along, and fails if the probabilities differ by more
+than --tolerance.
+
+The .svw format, little endian: the magic "SILVADW1", a uint32 tensor
+count, then per tensor a uint32 name length, the name, a uint32 rank, the
+uint32 dims and the float32 values.
+"""
+
+import argparse
+import struct
+import sys
+
+import numpy as np
+
+# ---------------------------------------------------------------------------
+# Minimal protobuf decoding of the ONNX messages used here
+# ---------------------------------------------------------------------------
+
+
+def _varint(buf, pos):
+    result = shift = 0
+    while True:
+        b = buf[pos]
+        pos += 1
+        result |= (b & 0x7F) << shift
+        if not b & 0x80:
+            return result, pos
+        shift += 7
+
+
+def _fields(buf):
+    """Yields (field number, wire type, value) for one message."""
+    pos = 0
+    while pos < len(buf):
+        key, pos = _varint(buf, pos)
+        field, wire = key >> 3, key & 7
+        if wire == 0:
+            value, pos = _varint(buf, pos)
+        elif wire == 1:
+            value, pos = buf[pos:pos + 8], pos + 8
+        elif wire == 2:
+            n, pos = _varint(buf, pos)
+            value, pos = buf[pos:pos + n], pos + n
+        elif wire == 5:
+            value, pos = buf[pos:pos + 4], pos + 4
+        else:
+            raise ValueError("unsupported protobuf wire type %d" % wire)
+        yield field, wire, value
+
+
+def _signed(v):
+    return v - (1 << 64) if v >= 1 << 63 else v
+
+
+def _ints(wire, value):
+    """Repeated int64: packed (wire 2) or one element (wire 0)."""
+    if wire == 0:
+        return [_signed(value)]
+    out, pos = [], 0
+    while pos < len(value):
+        v, pos = _varint(value, pos)
+        out.append(_signed(v))
+    return out
+
+
+_DTYPES = {1: np.float32, 2: np.uint8, 3: np.int8, 6: np.int32, 7: np.int64,
+           9: np.bool_, 10: np.float16, 11: np.float64}
+
+
+def _tensor(buf):
+    dims, dtype, name, raw = [], 1, "", None
+    floats, int32s, int64s, doubles = [], [], [], []
+    for field, wire, value in _fields(buf):
+        if field == 1:
+            dims += _ints(wire, value)
+        elif field == 2:
+            dtype = value
+        elif field == 4:
+            floats.append(np.frombuffer(bytes(value), "<f4"))
+        elif field == 5:
+            int32s += _ints(wire, value)
+        elif field == 7:
+            int64s += _ints(wire, value)
+        elif field == 8:
+            name = bytes(value).decode()
+        elif field == 9:
+            raw = bytes(value)
+        elif field == 10:
+            doubles.append(np.frombuffer(bytes(value), "<f8"))
+        elif field == 13:
+            raise ValueError("tensor %s uses external data, which is not supported" % name)
+    np_type = _DTYPES.get(dtype)
+    if np_type is None:
+        raise ValueError("tensor %s has unsupported data type %d" % (name, dtype))
+    if raw is not None:
+        arr = np.frombuffer(raw, np.dtype(np_type).newbyteorder("<"))
+    elif dtype == 1:
+        arr = np.concatenate(floats) if floats else np.zeros(0, np.float32)
+    elif dtype == 11:
+        arr = np.concatenate(doubles) if doubles else np.zeros(0, np.float64)
+    elif dtype == 7:
+        arr = np.array(int64s, np.int64)
+    else:
+        arr = np.array(int32s, np.int64).astype(np_type)
+    return name, arr.astype(np_type).reshape(dims)
+
+
+class Node:
+    def __init__(self, buf):
+        self.inputs, self.outputs, self.op, self.attrs = [], [], "", {}
+        for field, _, value in _fields(buf):
+            if field == 1:
+                self.inputs.append(bytes(value).decode())
+            elif field == 2:
+                self.outputs.append(bytes(value).decode())
+            elif field == 4:
+                self.op = bytes(value).decode()
+            elif field == 5:
+                self._attribute(value)
+
+    def _attribute(self, buf):
+        name, ints, value_set = "", [], None
+        for field, wire, value in _fields(buf):
+            if field == 1:
+                name = bytes(value).decode()
+            elif field == 2:
+                value_set = struct.unpack("<f", bytes(value))[0]
+            elif field == 3:
+                value_set = _signed(value)
+            elif field == 4:
+                value_set = bytes(value).decode(errors="replace")
+            elif field == 5:
+                value_set = _tensor(value)[1]
+            elif field == 6:
+                value_set = Graph(value)
+            elif field == 8:
+                ints += _ints(wire, value)
+        self.attrs[name] = ints if value_set is None else value_set
+
+
+class Graph:
+    def __init__(self, buf):
+        self.nodes, self.initializers = [], {}
+        for field, _, value in _fields(buf):
+            if field == 1:
+                self.nodes.append(Node(value))
+            elif field == 5:
+                name, arr = _tensor(value)
+                self.initializers[name] = arr
+
+    def subgraphs(self):
+        for node in self.nodes:
+            for attr in node.attrs.values():
+                if isinstance(attr, Graph):
+                    yield attr
+
+
+def load_model(path):
+    with open(path, "rb") as f:
+        data = memoryview(f.read())
+    for field, _, value in _fields(data):
+        if field == 7:
+            return Graph(value)
+    raise ValueError("%s has no graph" % path)
+
+
+# ---------------------------------------------------------------------------
+# Constant folding: weights may reach their consumers through reshapes,
+# slices and concats (the ONNX LSTM gate reordering is one).
+# ---------------------------------------------------------------------------
+
+
+class Constants:
+    def __init__(self, scopes):
+        self.values = {}
+        self.producers = {}
+        for graph in scopes:
+            self.values.update(graph.initializers)
+            for node in graph.nodes:
+                for out in node.outputs:
+                    self.producers[out] = node
+
+    def get(self, name):
+        if name in self.values:
+            return self.values[name]
+        node = self.producers.get(name)
+        if node is None:
+            return None
+        inputs = [self.get(i) if i else None for i in node.inputs]
+        if any(v is None for i, v in zip(node.inputs, inputs) if i):
+            return None
+        try:
+            outs = self._eval(node, inputs)
+        except (KeyError, ValueError, IndexError):
+            return None
+        if outs is None:
+            return None
+        for out, value in zip(node.outputs, outs):
+            self.values[out] = value
+        return self.values.get(name)
+
+    @staticmethod
+    def _axes(node, inputs, k):
+        if len(inputs) > k and inputs[k] is not None:
+            return [int(a) for a in inputs[k]]
+        return list(node.attrs.get("axes", []))
+
+    def _eval(self, node, x):
+        op, a = node.op, node.attrs
+        if op == "Constant":
+            return [a["value"]]
+        if op in ("Identity", "Cast"):
+            if op == "Cast":
+                return [x[0].astype(_DTYPES[a["to"]])]
+            return [x[0]]
+        if op == "Unsqueeze":
+            out = x[0]
+            for axis in sorted(self._axes(node, x, 1)):
+                out = np.expand_dims(out, axis if axis >= 0 else axis + out.ndim + 1)
+            return [out]
+        if op == "Squeeze":
+            axes = self._axes(node, x, 1)
+            return [np.squeeze(x[0], axis=tuple(axes)) if axes else np.squeeze(x[0])]
+        if op == "Reshape":
+            shape = [int(d) for d in x[1]]
+            shape = [x[0].shape[i] if d == 0 else d for i, d in enumerate(shape)]
+            return [x[0].reshape(shape)]
+        if op == "Transpose":
+            perm = a.get("perm") or None
+            return [np.transpose(x[0], perm)]
+        if op == "Concat":
+            return [np.concatenate(x, axis=a["axis"])]
+        if op == "Gather":
+            return [np.take(x[0], x[1], axis=a.get("axis", 0))]
+        if op == "Slice":
+            starts, ends = x[1], x[2]
+            axes = x[3] if len(x) > 3 and x[3] is not None else range(len(starts))
+            steps = x[4] if len(x) > 4 and x[4] is not None else [1] * len(starts)
+            index = [slice(None)] * x[0].ndim
+            for s, e, ax, st in zip(starts, ends, axes, steps):
+                index[int(ax)] = slice(int(s), int(min(e, np.iinfo(np.int64).max // 2)), int(st))
+            return [x[0][tuple(index)]]
+        if op == "Split":
+            axis = a.get("axis", 0)
+            sizes = x[1] if len(x) > 1 and x[1] is not None else a.get("split")
+            if sizes is None or len(sizes) == 0:
+                return list(np.split(x[0], len(node.outputs), axis=axis))
+            return list(np.split(x[0], np.cumsum(sizes)[:-1], axis=axis))
+        binary = {"Add": np.add, "Sub": np.subtract, "Mul": np.multiply, "Div": np.divide}
+        if op in binary:
+            return [binary[op](x[0], x[1])]
+        return None
+
+
+# ---------------------------------------------------------------------------
+# Locating the 16 kHz weights
+# ---------------------------------------------------------------------------
+
+
+def find_branch(graph, filter_length):
+    """Returns (branch, scopes): the graph holding the STFT conv with the
+    given kernel length, and the graphs whose names it can see."""
+    stack = [(graph, [graph])]
+    while stack:
+        g, scopes = stack.pop()
+        consts = Constants(scopes)
+        for node in g.nodes:
+            if node.op == "Conv":
+                w = consts.get(node.inputs[1])
+                if w is not None and w.ndim == 3 and w.shape[1] == 1 and w.shape[2] == filter_length:
+                    return g, scopes
+        for sub in g.subgraphs():
+            stack.append((sub, scopes + [sub]))
+    raise ValueError("no STFT convolution with a %d-sample kernel found" % filter_length)
+
+
+def lstm_weights(branch, consts, hidden):
+    """(weight [4H, 2H], bias [4H]) in gate order i, f, g, o."""
+    for node in branch.nodes:
+        if node.op == "LSTM":
+            W = consts.get(node.inputs[1])
+            R = consts.get(node.inputs[2])
+            B = consts.get(node.inputs[3]) if len(node.inputs) > 3 and node.inputs[3] else None
+            if W is None or R is None:
+                raise ValueError("LSTM weights are not constant")
+            W, R = W.reshape(4 * hidden, -1), R.reshape(4 * hidden, hidden)
+            B = np.zeros(8 * hidden, np.float32) if B is None else B.reshape(8 * hidden)
+            order = [0, 2, 3, 1]  # ONNX i, o, f, c -> i, f, g, o
+
+            def gates(m):
+                return np.concatenate([m[k * hidden:(k + 1) * hidden] for k in order])
+            weight = np.concatenate([gates(W), gates(R)], axis=1)
+            bias = gates(B[:4 * hidden]) + gates(B[4 * hidden:])
+            return weight, bias
+
+    # An LSTMCell exported as plain ops: two [.., 4H] projections (input
+    # first, then hidden) and their biases, already in PyTorch gate order.
+    mats, biases = [], []
+    for node in branch.nodes:
+        if node.op in ("MatMul", "Gemm"):
+            w = consts.get(node.inputs[1])
+            if w is None or w.ndim != 2 or 4 * hidden not in w.shape:
+                continue
+            trans = node.op == "Gemm" and node.attrs.get("transB", 0)
+            mats.append(w if trans or w.shape[0] == 4 * hidden and w.shape[1] != 4 * hidden else w.T)
+            if node.op == "Gemm" and len(node.inputs) > 2 and node.inputs[2]:
+                biases.append(consts.get(node.inputs[2]).reshape(-1))
+        elif node.op == "Add":
+            for name in node.inputs:
+                b = consts.get(name)
+                if b is not None and b.size == 4 * hidden:
+                    biases.append(b.reshape(-1))
+    if len(mats) != 2:
+        raise ValueError("could not find the LSTM weights (found %d projections)" % len(mats))
+    bias = np.sum(biases, axis=0) if biases else np.zeros(4 * hidden, np.float32)
+    return np.concatenate(mats, axis=1), bias
+
+
+def extract(path, sample_rate=16000):
+    filter_length = 256 if sample_rate == 16000 else 128
+    hidden = 128
+    model = load_model(path)
+    branch, scopes = find_branch(model, filter_length)
+    consts = Constants(scopes)
+
+    tensors = {}
+    pad = None
+    encoder = []
+    for node in branch.nodes:
+        if node.op == "Pad" and pad is None:
+            pads = consts.get(node.inputs[1]) if len(node.inputs) > 1 else None
+            pads = np.array(node.attrs.get("pads", []) if pads is None else pads).reshape(-1)
+            if node.attrs.get("mode", "constant") != "reflect":
+                raise ValueError("STFT padding is not reflect")
+            n = len(pads) // 2
+            pad = (int(pads[n - 1]), int(pads[2 * n - 1]))
+        elif node.op == "Conv":
+            w = consts.get(node.inputs[1])
+            b = consts.get(node.inputs[2]) if len(node.inputs) > 2 and node.inputs[2] else None
+            if w is None:
+                raise ValueError("Conv weight %s is not constant" % node.inputs[1])
+            if w.shape[1] == 1 and w.shape[2] == filter_length:
+                tensors["stft.basis"] = w.reshape(w.shape[0], filter_length)
+            elif w.shape[2] == 3:
+                encoder.append((w, b, node.attrs.get("strides", [1])[0]))
+            elif w.shape == (1, hidden, 1):
+                tensors["decoder.weight"] = w.reshape(hidden)
+                tensors["decoder.bias"] = np.zeros(1, np.float32) if b is None else b.reshape(1)
+
+    expected = [(128, filter_length // 2 + 1, 1), (64, 128, 2), (64, 64, 2), (128, 64, 1)]
+    found = [(w.shape[0], w.shape[1], s) for w, _, s in encoder]
+    if found != expected:
+        raise ValueError("unexpected encoder layout %s, wanted %s" % (found, expected))
+    for i, (w, b, _) in enumerate(encoder):
+        tensors["encoder.%d.weight" % i] = w
+        tensors["encoder.%d.bias" % i] = np.zeros(w.shape[0], np.float32) if b is None else b
+    if "stft.basis" not in tensors or "decoder.weight" not in tensors:
+        raise ValueError("STFT basis or decoder conv missing")
+    tensors["lstm.weight"], tensors["lstm.bias"] = lstm_weights(branch, consts, hidden)
+    if pad is None:
+        print("warning: no Pad node found; assuming reflect padding of %d on the right"
+              % (filter_length // 4), file=sys.stderr)
+        pad = (0, filter_length // 4)
+
+    tensors["sample_rate"] = np.array([sample_rate], np.float32)
+    tensors["filter_length"] = np.array([filter_length], np.float32)
+    tensors["hop_length"] = np.array([filter_length // 2], np.float32)
+    tensors["pad_left"] = np.array([pad[0]], np.float32)
+    tensors["pad_right"] = np.array([pad[1]], np.float32)
+    tensors["context"] = np.array([64 if sample_rate == 16000 else 32], np.float32)
+    tensors["window"] = np.array([512 if sample_rate == 16000 else 256], np.float32)
+    return {k: np.ascontiguousarray(v, np.float32) for k, v in tensors.items()}
+
+
+def write_svw(path, tensors):
+    with open(path, "wb") as f:
+        f.write(b"SILVADW1")
+        f.write(struct.pack("<I", len(tensors)))
+        for name, arr in tensors.items():
+            raw = name.encode()
+            f.write(struct.pack("<I", len(raw)) + raw)
+            f.write(struct.pack("<I", arr.ndim))
+            f.write(struct.pack("<%dI" % arr.ndim, *arr.shape))
+            f.write(arr.astype("<f4").tobytes())
+
+
+# ---------------------------------------------------------------------------
+# Reference forward pass, mirroring native::SileroNet::forward()
+# ---------------------------------------------------------------------------
+
+
+def forward(t, x, state):
+    """x: [context + window] samples, state: [2, 128]. Returns (prob, state)."""
+    def sigmoid(v):
+        return 1.0 / (1.0 + np.exp(-v))
+
+    fl, hop = int(t["filter_length"][0]), int(t["hop_length"][0])
+    left, right = int(t["pad_left"][0]), int(t["pad_right"][0])
+    x = np.pad(x, (left, right), mode="reflect")
+    frames = np.stack([x[f * hop:f * hop + fl] for f in range((len(x) - fl) // hop + 1)], axis=1)
+    spec = t["stft.basis"] @ frames
+    bins = spec.shape[0] // 2
+    h = np.sqrt(spec[:bins] ** 2 + spec[bins:] ** 2)
+    for i, stride in enumerate((1, 2, 2, 1)):
+        w, b = t["encoder.%d.weight" % i], t["encoder.%d.bias" % i]
+        xp = np.pad(h, ((0, 0), (1, 1)))
+        n = (h.shape[1] + 2 - 3) // stride + 1
+        cols = np.stack([xp[:, j * stride:j * stride + 3].reshape(-1) for j in range(n)], axis=1)
+        h = np.maximum(0.0, w.reshape(w.shape[0], -1) @ cols + b[:, None])
+    hid = state.shape[1]
+    gates = t["lstm.weight"] @ np.concatenate([h[:, -1], state[0]]) + t["lstm.bias"]
+    i, f, g, o = (gates[k * hid:(k + 1) * hid] for k in range(4))
+    c = sigmoid(f) * state[1] + sigmoid(i) * np.tanh(g)
+    hn = sigmoid(o) * np.tanh(c)
+    logit = t["decoder.weight"] @ np.maximum(0.0, hn) + t["decoder.bias"][0]
+    return float(sigmoid(logit)), np.stack([hn, c])
+
+
+def verify(model_path, tensors, windows, tolerance):
+    try:
+        import onnxruntime as ort
+    except ImportError:
+        print("error: --verify needs the onnxruntime Python package", file=sys.stderr)
+        return False
+    session = ort.InferenceSession(model_path, providers=["CPUExecutionProvider"])
+    rng = np.random.default_rng(1)
+    n = int(tensors["context"][0] + tensors["window"][0])
+    ort_state = np.zeros((2, 1, 128), np.float32)
+    ref_state = np.zeros((2, 128), np.float32)
+    worst = 0.0
+    for k in range(windows):
+        # Alternate noise and tones so both speech and silence states occur.
+        if (k // 20) % 2:
+            x = (0.3 * np.sin(np.arange(n) * (0.05 + 0.01 * (k % 7)))).astype(np.float32)
+        else:
+            x = (0.01 * rng.standard_normal(n)).astype(np.float32)
+        prob, ort_state = session.run(None, {"input": x[None, :], "state": ort_state,
+                                             "sr": np.array(16000, np.int64)})
+        ref, ref_state = forward(tensors, x.astype(np.float64), ref_state)
+        worst = max(worst, abs(float(prob.reshape(-1)[0]) - ref))
+    print("max |onnx - native| over %d windows: %.2e" % (windows, worst))
+    return worst <= tolerance
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("model", help="silero_vad.onnx")
+    parser.add_argument("output", help="weights file to write (.svw)")
+    parser.add_argument("--verify", action="store_true",
+                        help="compare against onnxruntime on random windows")
+    parser.add_argument("--windows", type=int, default=200, help="windows for --verify")
+    parser.add_argument("--tolerance", type=float, default=1e-4,
+                        help="largest allowed probability difference for --verify")
+    args = parser.parse_args()
+
+    try:
+        tensors = extract(args.model)
+    except (OSError, ValueError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    write_svw(args.output, tensors)
+    print("wrote %s (%d tensors, STFT padding %d/%d)"
+          % (args.output, len(tensors), tensors["pad_left"][0], tensors["pad_right"][0]))
+    if args.verify and not verify(args.model, tensors, args.windows, args.tolerance):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
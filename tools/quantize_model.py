@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""Writes an INT8 variant of silero_vad.onnx for `vad --int8` and reports
+how far its segments move against the FP32 model.
+
+    python3 tools/quantize_model.py silero_vad.onnx                 # dynamic
+    python3 tools/quantize_model.py silero_vad.onnx --mode static \\
+        --calibrate corpus/ --report corpus/
+
+The output defaults to <name>.int8.onnx next to the input, which is where
+vad, vad_bench and the realtime tools look for it with --int8.
+
+The Silero model selects its 8 kHz or 16 kHz network in an If node, and
+ONNX Runtime's quantizer neither calibrates nor rewrites tensors inside
+subgraphs well. The 16 kHz branch is therefore inlined into the main
+graph first, so the INT8 model serves 16 kHz only, the tools' default
+rate; they refuse --int8 with --sample-rate=8000.
+
+dynamic  weights are quantized ahead of time and activations per call;
+         no calibration data is needed.
+static   activations are quantized too, with ranges calibrated on WAV
+         files (--calibrate). The calibration windows are stepped through
+         the FP32 model so the LSTM state looks like it does on real audio.
+
+By default the STFT convolution stays in FP32: the spectrum magnitude is
+where quantization noise costs the most accuracy for the least speed.
+--quantize-stft includes it.
+
+--report runs `vad --model=FP32 --compare=INT8` over the given files or
+directories and prints the probability, decision and segment boundary
+differences per recording and pooled, plus the inference time of each.
+
+Needs the onnx and onnxruntime Python packages.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import wave
+
+import numpy as np
+
+try:
+    import onnx
+    from onnx import helper
+    import onnxruntime as ort
+    from onnxruntime.quantization import (CalibrationDataReader, CalibrationMethod, QuantFormat,
+                                          QuantType, quantize_dynamic, quantize_static)
+except ImportError as e:
+    sys.exit("error: %s (pip install onnx onnxruntime)" % e)
+
+SAMPLE_RATE = 16000
+WINDOW = 512
+CONTEXT = 64
+
+
+# ---------------------------------------------------------------------------
+# Graph preparation
+# ---------------------------------------------------------------------------
+
+
+def _constant_shapes(graph, outer):
+    """Shapes of the initializers and Constant outputs visible in graph."""
+    shapes = dict(outer)
+    for init in graph.initializer:
+        shapes[init.name] = list(init.dims)
+    for node in graph.node:
+        if node.op_type == "Constant":
+            for attr in node.attribute:
+                if attr.name == "value":
+                    shapes[node.output[0]] = list(attr.t.dims)
+    return shapes
+
+
+def _stft_convs(graph, shapes, kernel):
+    """Names of the Conv nodes in graph whose weight is [*, 1, kernel]."""
+    found = []
+    for node in graph.node:
+        if node.op_type == "Conv":
+            dims = shapes.get(node.input[1])
+            if dims is not None and len(dims) == 3 and dims[1] == 1 and dims[2] == kernel:
+                found.append(node.name)
+    return found
+
+
+def inline_16k_branch(model):
+    """Replaces the If node that picks the sample rate with its 16 kHz
+    branch. Models without one are returned unchanged."""
+    graph = model.graph
+    outer = _constant_shapes(graph, {})
+    nodes = []
+    inlined = False
+    for node in graph.node:
+        branch = None
+        if node.op_type == "If" and not inlined:
+            for attr in node.attribute:
+                if attr.type == onnx.AttributeProto.GRAPH:
+                    g = attr.g
+                    if _stft_convs(g, _constant_shapes(g, outer), 256):
+                        branch = g
+        if branch is None:
+            nodes.append(node)
+            continue
+        nodes.extend(branch.node)
+        graph.initializer.extend(branch.initializer)
+        for outer_name, inner in zip(node.output, branch.output):
+            nodes.append(helper.make_node("Identity", [inner.name], [outer_name]))
+        inlined = True
+    del graph.node[:]
+    graph.node.extend(nodes)
+    # Nodes inside subgraphs are often unnamed; the quantizer needs names.
+    for i, node in enumerate(graph.node):
+        if not node.name:
+            node.name = "%s_%d" % (node.op_type, i)
+    return inlined
+
+
+# ---------------------------------------------------------------------------
+# Calibration
+# ---------------------------------------------------------------------------
+
+
+def read_wav_16k(path):
+    """PCM WAV as 16 kHz mono float32; other rates are resampled linearly,
+    which is good enough for calibration statistics."""
+    with wave.open(path, "rb") as w:
+        channels, width, rate = w.getnchannels(), w.getsampwidth(), w.getframerate()
+        raw = w.readframes(w.getnframes())
+    if width == 1:
+        x = (np.frombuffer(raw, np.uint8).astype(np.float32) - 128.0) / 128.0
+    elif width == 2:
+        x = np.frombuffer(raw, "<i2").astype(np.float32) / 32768.0
+    elif width == 3:
+        b = np.frombuffer(raw, np.uint8).reshape(-1, 3).astype(np.int32)
+        v = b[:, 0] | (b[:, 1] << 8) | (b[:, 2] << 16)
+        x = (np.where(v >= 1 << 23, v - (1 << 24), v)).astype(np.float32) / 8388608.0
+    else:
+        x = np.frombuffer(raw, "<i4").astype(np.float32) / 2147483648.0
+    x = x.reshape(-1, channels).mean(axis=1)
+    if rate != SAMPLE_RATE:
+        t = np.arange(int(len(x) * SAMPLE_RATE / rate)) * (rate / SAMPLE_RATE)
+        x = np.interp(t, np.arange(len(x)), x).astype(np.float32)
+    return x
+
+
+def wav_files(paths):
+    out = []
+    for p in paths:
+        if os.path.isdir(p):
+            out += sorted(os.path.join(p, f) for f in os.listdir(p) if f.lower().endswith(".wav"))
+        else:
+            out.append(p)
+    return out
+
+
+class WavCalibration(CalibrationDataReader):
+    """Model inputs for consecutive windows of the calibration files, with
+    the state carried by the FP32 model."""
+
+    def __init__(self, model_path, files, max_windows):
+        self.session = ort.InferenceSession(model_path, providers=["CPUExecutionProvider"])
+        self.items = self._windows(files, max_windows)
+
+    def _windows(self, files, max_windows):
+        sr = np.array(SAMPLE_RATE, np.int64)
+        count = 0
+        for path in files:
+            try:
+                samples = read_wav_16k(path)
+            except (wave.Error, EOFError) as e:
+                print("warning: skipping %s: %s" % (path, e), file=sys.stderr)
+                continue
+            state = np.zeros((2, 1, 128), np.float32)
+            context = np.zeros(CONTEXT, np.float32)
+            for start in range(0, len(samples) - WINDOW + 1, WINDOW):
+                x = np.concatenate([context, samples[start:start + WINDOW]])[None, :]
+                feed = {"input": x, "state": state, "sr": sr}
+                yield {k: v.copy() for k, v in feed.items()}
+                _, state = self.session.run(None, feed)
+                context = x[0, -CONTEXT:]
+                count += 1
+                if count >= max_windows:
+                    return
+
+    def get_next(self):
+        return next(self.items, None)
+
+
+# ---------------------------------------------------------------------------
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("model", help="FP32 silero_vad.onnx")
+    parser.add_argument("-o", "--output", help="INT8 model to write (default: <name>.int8.onnx)")
+    parser.add_argument("--mode", choices=["dynamic", "static"], default="dynamic")
+    parser.add_argument("--calibrate", nargs="+", metavar="WAV_OR_DIR", default=[],
+                        help="calibration audio for --mode static")
+    parser.add_argument("--windows", type=int, default=5000,
+                        help="calibration windows to use at most (default: 5000)")
+    parser.add_argument("--per-channel", action="store_true", help="per-channel weight scales")
+    parser.add_argument("--quantize-stft", action="store_true", help="quantize the STFT conv too")
+    parser.add_argument("--report", nargs="+", metavar="WAV_OR_DIR", default=[],
+                        help="compare INT8 against FP32 on these recordings with vad")
+    parser.add_argument("--vad", default="./vad", help="vad binary for --report (default: ./vad)")
+    args = parser.parse_args()
+
+    output = args.output or os.path.splitext(args.model)[0] + ".int8.onnx"
+    if args.mode == "static" and not args.calibrate:
+        parser.error("--mode static needs --calibrate")
+
+    model = onnx.load(args.model)
+    inlined = inline_16k_branch(model)
+    excluded = [] if args.quantize_stft else _stft_convs(model.graph, _constant_shapes(model.graph, {}), 256)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        prepared = os.path.join(tmp, "fp32_16k.onnx")
+        onnx.save(model, prepared)
+        if args.mode == "dynamic":
+            quantize_dynamic(prepared, output, weight_type=QuantType.QInt8,
+                             per_channel=args.per_channel, nodes_to_exclude=excluded,
+                             op_types_to_quantize=["Conv", "MatMul", "Gemm", "LSTM"])
+        else:
+            files = wav_files(args.calibrate)
+            reader = WavCalibration(prepared, files, args.windows)
+            quantize_static(prepared, output, reader, quant_format=QuantFormat.QDQ,
+                            activation_type=QuantType.QUInt8, weight_type=QuantType.QInt8,
+                            per_channel=args.per_channel, nodes_to_exclude=excluded,
+                            op_types_to_quantize=["Conv", "MatMul", "Gemm"],
+                            calibrate_method=CalibrationMethod.MinMax)
+
+    size_in, size_out = os.path.getsize(args.model), os.path.getsize(output)
+    print("wrote %s (%s, %d -> %d bytes%s%s)" % (
+        output, args.mode, size_in, size_out,
+        ", 16 kHz branch inlined" if inlined else "",
+        ", STFT kept in FP32" if excluded else ""))
+
+    if args.report:
+        cmd = [args.vad, "--model=" + args.model, "--compare=" + output] + args.report
+        print("$ " + " ".join(cmd), flush=True)
+        return subprocess.call(cmd)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
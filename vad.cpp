@@ -15,376 +15,1213 @@
 #include <cstdio>
 #include <cstdarg>
 #include <cmath>    // for std::rint
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <functional>
+#include <map>
+#include <exception>
+#include <mutex>
 #if __cplusplus < 201703L
 #include <memory>
 #endif
 
-//#define __DEBUG_SPEECH_PROB___
-
-#include "onnxruntime_cxx_api.h"
+#include "vad_iterator.h"
 #include "wav.h" // For reading WAV files
+#include "thread_pool.h"
+#include "frontend.h"
+#include "chunking.h"
+#include "prob_track.h"
 
-// timestamp_t class: stores the start and end (in samples) of a speech segment.
-class timestamp_t {
-public:
-    int start;
-    int end;
-
-    timestamp_t(int start = -1, int end = -1)
-        : start(start), end(end) { }
-
-    timestamp_t& operator=(const timestamp_t& a) {
-        start = a.start;
-        end = a.end;
-        return *this;
-    }
-
-    bool operator==(const timestamp_t& a) const {
-        return (start == a.start && end == a.end);
-    }
-
-    // Returns a formatted string of the timestamp.
-    std::string c_str() const {
-        return format("{start:%08d, end:%08d}", start, end);
-    }
-private:
-    // Helper function for formatting.
-    std::string format(const char* fmt, ...) const {
-        char buf[256];
-        va_list args;
-        va_start(args, fmt);
-        const auto r = std::vsnprintf(buf, sizeof(buf), fmt, args);
-        va_end(args);
-        if (r < 0)
-            return {};
-        const size_t len = r;
-        if (len < sizeof(buf))
-            return std::string(buf, len);
-#if __cplusplus >= 201703L
-        std::string s(len, '\0');
-        va_start(args, fmt);
-        std::vsnprintf(s.data(), len + 1, fmt, args);
-        va_end(args);
-        return s;
-#else
-        auto vbuf = std::unique_ptr<char[]>(new char[len + 1]);
-        va_start(args, fmt);
-        std::vsnprintf(vbuf.get(), len + 1, fmt, args);
-        va_end(args);
-        return std::string(vbuf.get(), len);
+#ifdef __COUNT_ALLOCS___
+// Counting replacement for the global allocator; see alloc_stats in vad_iterator.h.
+void* operator new(std::size_t n) {
+    alloc_stats::total()++;
+    if (alloc_stats::running())
+        alloc_stats::in_run()++;
+    if (void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
 #endif
+
+static bool is_regular_file(const std::string& path) {
+    std::error_code ec;
+    return std::filesystem::is_regular_file(path, ec);
+}
+
+// Frames per block when WAV data goes through the front-end.
+static const size_t kFrontendBlockFrames = 64 * 512;
+
+// Sample rate the model runs at (--sample-rate): 16000, or 8000 with
+// 256-sample windows. Input is converted to it, and timestamps, probability
+// tracks and exported audio are at this rate.
+static int model_rate = 16000;
+
+// Samples per 32 ms window at model_rate.
+static int window_samples() { return model_rate / 1000 * 32; }
+
+// Decodes a mapped WAV file to mono at model_rate, downmixing and
+// resampling through the front-end unless the file already is.
+static void decode_mono(const wav::WavMmapReader& reader, std::vector<float>& out) {
+    const size_t num_frames = reader.num_samples();
+    const int channels = reader.num_channel();
+    frontend::AudioFrontend front(reader.sample_rate(), channels, model_rate);
+    if (front.passthrough()) {
+        out.resize(num_frames);
+        reader.Convert(0, num_frames, out.data());
+        return;
+    }
+    out.clear();
+    out.reserve(static_cast<size_t>(static_cast<double>(num_frames) * model_rate / reader.sample_rate()) + 1);
+    std::vector<float> block(kFrontendBlockFrames * channels);
+    for (size_t f = 0; f < num_frames; f += kFrontendBlockFrames) {
+        const size_t frames = std::min(kFrontendBlockFrames, num_frames - f);
+        reader.Convert(f * channels, frames * channels, block.data());
+        size_t n;
+        const float* mono = front.process(block.data(), frames, &n);
+        out.insert(out.end(), mono, mono + n);
+    }
+}
+
+// Loads a WAV file into a float vector as mono at model_rate; returns
+// false if it has no samples.
+static bool load_wav(const std::string& wav_path, std::vector<float>& input_wav) {
+    if (is_regular_file(wav_path)) {
+        wav::WavMmapReader reader;
+        if (!reader.Open(wav_path) || reader.num_samples() == 0) {
+            std::cerr << "Error: WAV file has zero samples or failed to load: "
+                      << wav_path << "\n";
+            return false;
+        }
+        decode_mono(reader, input_wav);
+        return true;
+    }
+
+    wav::WavReader wav_reader(wav_path.c_str());
+    int numSamples = wav_reader.num_samples();
+
+    if (numSamples == 0) {
+        std::cerr << "Error: WAV file has zero samples or failed to load: "
+                  << wav_path << "\n";
+        return false;
+    }
+
+    frontend::AudioFrontend front(wav_reader.sample_rate(), wav_reader.num_channel(), model_rate);
+    size_t n;
+    const float* mono = front.process(wav_reader.data(), static_cast<size_t>(numSamples), &n);
+    input_wav.assign(mono, mono + n);
+    return true;
+}
+
+// Streams a WAV file through vad block by block, so memory use stays
+// constant whatever the file length. Other rates and multichannel audio
+// pass through the front-end on the way. Returns false if it has no samples.
+static bool stream_wav(const std::string& wav_path, VadIterator& vad) {
+    wav::WavStreamReader reader;
+    if (!reader.Open(wav_path) || reader.num_samples() == 0) {
+        std::cerr << "Error: WAV file has zero samples or failed to load: "
+                  << wav_path << "\n";
+        return false;
+    }
+
+    const int channels = reader.num_channel();
+    frontend::AudioFrontend front(reader.sample_rate(), channels, model_rate);
+    std::vector<float> block(kFrontendBlockFrames * channels);
+    vad.reset();
+    size_t got;
+    while ((got = reader.Read(block.data(), block.size())) > 0) {
+        size_t n;
+        const float* mono = front.process(block.data(), got / channels, &n);
+        vad.feed(mono, n);
+    }
+    vad.finish();
+    return true;
+}
+
+// Runs a WAV file through vad. Regular files are memory-mapped; mono
+// windows at model_rate are converted straight into the inference buffer, anything
+// else goes through the front-end block by block. Pipes and other special
+// files fall back to block streaming.
+static bool run_wav(const std::string& wav_path, VadIterator& vad) {
+    if (!is_regular_file(wav_path))
+        return stream_wav(wav_path, vad);
+
+    wav::WavMmapReader reader;
+    if (!reader.Open(wav_path) || reader.num_samples() == 0) {
+        std::cerr << "Error: WAV file has zero samples or failed to load: "
+                  << wav_path << "\n";
+        return false;
+    }
+
+    const size_t num_samples = reader.num_samples();
+    const int channels = reader.num_channel();
+    frontend::AudioFrontend front(reader.sample_rate(), channels, model_rate);
+    vad.reset();
+    if (!front.passthrough()) {
+        std::vector<float> block(kFrontendBlockFrames * channels);
+        for (size_t f = 0; f < num_samples; f += kFrontendBlockFrames) {
+            const size_t frames = std::min(kFrontendBlockFrames, num_samples - f);
+            reader.Convert(f * channels, frames * channels, block.data());
+            size_t n;
+            const float* mono = front.process(block.data(), frames, &n);
+            vad.feed(mono, n);
+        }
+        vad.finish();
+        return true;
+    }
+
+    const size_t window_size_samples = vad.window_size();
+    size_t j = 0;
+    for (; j + window_size_samples <= num_samples; j += window_size_samples) {
+        reader.Convert(j, window_size_samples, vad.window_input());
+        vad.commit_window();
+    }
+    // The trailing partial window only counts towards the audio length.
+    std::vector<float> tail(num_samples - j);
+    reader.Convert(j, tail.size(), tail.data());
+    vad.feed(tail.data(), tail.size());
+    vad.finish();
+    return true;
+}
+
+// Prints the speech timestamps of one recording, given in samples at
+// sample_rate.
+static void print_timestamps(const std::vector<timestamp_t>& stamps, int sample_rate, std::ostream& out) {
+    const float sample_rate_float = static_cast<float>(sample_rate);
+
+    for (size_t i = 0; i < stamps.size(); i++) {
+        float start_sec = std::rint((stamps[i].start / sample_rate_float) * 10.0f) / 10.0f;
+        float end_sec = std::rint((stamps[i].end  / sample_rate_float) * 10.0f) / 10.0f;
+        out << "Speech detected from "
+            << std::fixed << std::setprecision(1) << start_sec
+            << " s to "
+            << std::fixed << std::setprecision(1) << end_sec << " s\n";
+    }
+}
+
+// Chunking settings from the command line: with enabled, segments are
+// merged and cut into chunks (chunking.h) before they are printed.
+struct ChunkSettings {
+    bool enabled = false;
+    chunking::ChunkOptions options;
+};
+
+// Prints the chunks of one recording, one "<start> to <end>" line each in
+// seconds, the format the merging_utils pipeline produced.
+static void print_chunks(const std::vector<timestamp_t>& chunks, int sample_rate, std::ostream& out) {
+    char line[64];
+    for (const timestamp_t& c : chunks) {
+        std::snprintf(line, sizeof(line), "%.3f to %.3f\n", c.start / double(sample_rate), c.end / double(sample_rate));
+        out << line;
+    }
+}
+
+// Prints the result for one recording: its segments, or its chunks.
+// Timestamps are at model_rate unless sample_rate says otherwise.
+static void print_result(const std::vector<timestamp_t>& stamps, const ChunkSettings& chunk,
+                         std::ostream& out = std::cout, int sample_rate = 0) {
+    if (sample_rate == 0)
+        sample_rate = model_rate;
+    if (chunk.enabled) {
+        chunking::ChunkOptions options = chunk.options;
+        options.sample_rate = sample_rate;
+        print_chunks(chunking::make_chunks(stamps, options), sample_rate, out);
+    } else {
+        print_timestamps(stamps, sample_rate, out);
+    }
+}
+
+// The ranges print_result() reports: the segments, or their chunks.
+static std::vector<timestamp_t> result_ranges(const std::vector<timestamp_t>& stamps, const ChunkSettings& chunk) {
+    if (!chunk.enabled)
+        return stamps;
+    chunking::ChunkOptions options = chunk.options;
+    options.sample_rate = model_rate;
+    return chunking::make_chunks(stamps, options);
+}
+
+// Segmentation parameters from the command line; the defaults are
+// VadIterator's.
+struct SegmentParams {
+    float threshold = 0.5f;
+    int min_silence_ms = 100;
+    int speech_pad_ms = 30;
+    int min_speech_ms = 250;
+    float max_speech_s = std::numeric_limits<float>::infinity();
+
+    VadSegmenter segmenter(int sample_rate = model_rate, int window_ms = 32) const {
+        return VadSegmenter(sample_rate, window_ms, threshold, min_silence_ms, speech_pad_ms,
+                            min_speech_ms, max_speech_s);
     }
 };
 
-// VadIterator class: uses ONNX Runtime to detect speech segments.
-class VadIterator {
-private:
-    // ONNX Runtime resources
-    Ort::Env env;
-    Ort::SessionOptions session_options;
-    std::shared_ptr<Ort::Session> session = nullptr;
-    Ort::AllocatorWithDefaultOptions allocator;
-    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
-
-    // ----- Context-related additions -----
-    const int context_samples = 64;  // For 16kHz, 64 samples are added as context.
-    std::vector<float> _context;     // Holds the last 64 samples from the previous chunk (initialized to zero).
-
-    // Original window size (e.g., 32ms corresponds to 512 samples)
-    int window_size_samples;
-    // Effective window size = window_size_samples + context_samples
-    int effective_window_size;
-
-    // Additional declaration: samples per millisecond
-    int sr_per_ms;
-
-    // ONNX Runtime input/output buffers
-    std::vector<Ort::Value> ort_inputs;
-    std::vector<const char*> input_node_names = { "input", "state", "sr" };
-    std::vector<float> input;
-    unsigned int size_state = 2 * 1 * 128;
-    std::vector<float> _state;
-    std::vector<int64_t> sr;
-    int64_t input_node_dims[2] = {};
-    const int64_t state_node_dims[3] = { 2, 1, 128 };
-    const int64_t sr_node_dims[1] = { 1 };
-    std::vector<Ort::Value> ort_outputs;
-    std::vector<const char*> output_node_names = { "output", "stateN" };
-
-    // Model configuration parameters
-    int sample_rate;
-    float threshold;
-    int min_silence_samples;
-    int min_silence_samples_at_max_speech;
-    int min_speech_samples;
-    float max_speech_samples;
-    int speech_pad_samples;
-    int audio_length_samples;
-
-    // State management
-    bool triggered = false;
-    unsigned int temp_end = 0;
-    unsigned int current_sample = 0;
-    int prev_end;
-    int next_start = 0;
-    std::vector<timestamp_t> speeches;
-    timestamp_t current_speech;
-
-    // Loads the ONNX model.
-    void init_onnx_model(const std::string& model_path) {
-        init_engine_threads(1, 1);
-        session = std::make_shared<Ort::Session>(env, model_path.c_str(), session_options);
-    }
-
-    // Initializes threading settings.
-    void init_engine_threads(int inter_threads, int intra_threads) {
-        session_options.SetIntraOpNumThreads(intra_threads);
-        session_options.SetInterOpNumThreads(inter_threads);
-        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-    }
-
-    // Resets internal state (_state, _context, etc.)
-    void reset_states() {
-        std::memset(_state.data(), 0, _state.size() * sizeof(float));
-        triggered = false;
-        temp_end = 0;
-        current_sample = 0;
-        prev_end = next_start = 0;
-        speeches.clear();
-        current_speech = timestamp_t();
-        std::fill(_context.begin(), _context.end(), 0.0f);
-    }
-
-    // Inference: runs inference on one chunk of input data.
-    // data_chunk is expected to have window_size_samples samples.
-    void predict(const std::vector<float>& data_chunk) {
-        // Build new input: first context_samples from _context, followed by the current chunk (window_size_samples).
-        std::vector<float> new_data(effective_window_size, 0.0f);
-        std::copy(_context.begin(), _context.end(), new_data.begin());
-        std::copy(data_chunk.begin(), data_chunk.end(), new_data.begin() + context_samples);
-        input = new_data;
-
-        // Create input tensor (input_node_dims[1] is already set to effective_window_size).
-        Ort::Value input_ort = Ort::Value::CreateTensor<float>(
-            memory_info, input.data(), input.size(), input_node_dims, 2);
-        Ort::Value state_ort = Ort::Value::CreateTensor<float>(
-            memory_info, _state.data(), _state.size(), state_node_dims, 3);
-        Ort::Value sr_ort = Ort::Value::CreateTensor<int64_t>(
-            memory_info, sr.data(), sr.size(), sr_node_dims, 1);
-        ort_inputs.clear();
-        ort_inputs.emplace_back(std::move(input_ort));
-        ort_inputs.emplace_back(std::move(state_ort));
-        ort_inputs.emplace_back(std::move(sr_ort));
-
-        // Run inference.
-        ort_outputs = session->Run(
-            Ort::RunOptions{ nullptr },
-            input_node_names.data(), ort_inputs.data(), ort_inputs.size(),
-            output_node_names.data(), output_node_names.size());
-
-        float speech_prob = ort_outputs[0].GetTensorMutableData<float>()[0];
-        float* stateN = ort_outputs[1].GetTensorMutableData<float>();
-        std::memcpy(_state.data(), stateN, size_state * sizeof(float));
-        current_sample += static_cast<unsigned int>(window_size_samples); // Advance by the original window size.
-
-        // If speech is detected (probability >= threshold)
-        if (speech_prob >= threshold) {
-#ifdef __DEBUG_SPEECH_PROB___
-            float speech = current_sample - window_size_samples;
-            printf("{ start: %.3f s (%.3f) %08d}\n", 1.0f * speech / sample_rate, speech_prob, current_sample - window_size_samples);
-#endif
-            if (temp_end != 0) {
-                temp_end = 0;
-                if (next_start < prev_end)
-                    next_start = current_sample - window_size_samples;
+// Where --save-probs writes the probability track of each input:
+// dir/<name>.vadp, at bits per window.
+struct ProbOutput {
+    std::string dir;
+    int bits = 16;
+
+    bool enabled() const { return !dir.empty(); }
+
+    // Writes the track of wav_path; false (with a message) on failure.
+    bool save(const std::string& wav_path, const std::vector<float>& probs, size_t audio_samples) const {
+        ProbTrack track;
+        track.sample_rate = model_rate;
+        track.window_samples = window_samples();
+        track.probs = probs;
+        track.audio_samples = audio_samples;
+        std::filesystem::path dst = std::filesystem::path(dir) /
+            (std::filesystem::path(wav_path).stem().string() + ".vadp");
+        try {
+            track.save(dst.string(), bits);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return false;
+        }
+        return true;
+    }
+};
+
+// Where --export writes the audio of each recording's ranges (segments,
+// or chunks with --chunk): dir/<name>_0001.wav and on, one file per range,
+// or with concat a single dir/<name>.speech.wav with the ranges back to
+// back and a cue point where each starts. Output is mono 16-bit at
+// model_rate, the audio the timestamps refer to. Mono PCM16 and float
+// inputs at that rate are written straight from the mapped file; anything
+// else is decoded through the front-end first.
+struct SegmentExport {
+    std::string dir;
+    bool concat = false;
+
+    bool enabled() const { return !dir.empty(); }
+
+    // Writes the ranges of wav_path; false (with a message) on failure.
+    bool write(const std::string& wav_path, const std::vector<timestamp_t>& ranges) const {
+        if (!is_regular_file(wav_path)) {
+            std::cerr << "Error: --export needs a regular WAV file: " << wav_path << "\n";
+            return false;
+        }
+        wav::WavMmapReader reader;
+        if (!reader.Open(wav_path)) {
+            std::cerr << "Error: cannot read WAV file: " << wav_path << "\n";
+            return false;
+        }
+
+        // One slice of the mono audio at model_rate, without copying it first.
+        std::vector<float> decoded;
+        std::function<bool(wav::WavFileWriter&, size_t, size_t)> put;
+        size_t num_samples = reader.num_samples();
+        const bool native_rate = reader.sample_rate() == model_rate && reader.num_channel() == 1;
+        if (native_rate && reader.bits_per_sample() == 16) {
+            const int16_t* pcm = reinterpret_cast<const int16_t*>(reader.raw_data());
+            put = [pcm](wav::WavFileWriter& w, size_t a, size_t b) { return w.WriteS16(pcm + a, b - a); };
+        } else if (native_rate && reader.bits_per_sample() == 32 && reader.format() == 3) {
+            const float* pcm = reinterpret_cast<const float*>(reader.raw_data());
+            put = [pcm](wav::WavFileWriter& w, size_t a, size_t b) { return w.WriteFloat(pcm + a, b - a); };
+        } else {
+            decode_mono(reader, decoded);
+            num_samples = decoded.size();
+            put = [&decoded](wav::WavFileWriter& w, size_t a, size_t b) {
+                return w.WriteFloat(decoded.data() + a, b - a);
+            };
+        }
+
+        const std::string stem = (std::filesystem::path(dir) / std::filesystem::path(wav_path).stem()).string();
+        wav::WavFileWriter writer;
+        if (concat && !writer.Open(stem + ".speech.wav", model_rate, 1)) {
+            std::cerr << "Error: cannot write " << stem << ".speech.wav\n";
+            return false;
+        }
+        char suffix[32];
+        for (size_t k = 0; k < ranges.size(); k++) {
+            const size_t a = std::min(num_samples, static_cast<size_t>(std::max<int64_t>(0, ranges[k].start)));
+            const size_t b = std::min(num_samples, static_cast<size_t>(std::max<int64_t>(0, ranges[k].end)));
+            std::snprintf(suffix, sizeof(suffix), "_%04zu.wav", k + 1);
+            if (concat) {
+                writer.AddCue();
+            } else if (!writer.Open(stem + suffix, model_rate, 1)) {
+                std::cerr << "Error: cannot write " << stem << suffix << "\n";
+                return false;
             }
-            if (!triggered) {
-                triggered = true;
-                current_speech.start = current_sample - window_size_samples;
+            bool ok = b <= a || put(writer, a, b);
+            if (!concat)
+                ok = writer.Close() && ok;
+            if (!ok) {
+                std::cerr << "Error: cannot write " << stem << (concat ? ".speech.wav" : suffix) << "\n";
+                return false;
             }
-            // Update context: copy the last context_samples from new_data.
-            std::copy(new_data.end() - context_samples, new_data.end(), _context.begin());
+        }
+        if (concat && !writer.Close()) {
+            std::cerr << "Error: cannot write " << stem << ".speech.wav\n";
+            return false;
+        }
+        return true;
+    }
+};
+
+// Energy pre-gate settings from the command line; floor_dbfs of 0 or
+// above leaves the gate off.
+struct GateOptions {
+    float floor_dbfs = 0.0f;
+    int warmup_windows = 8;
+
+    bool enabled() const { return floor_dbfs < 0.0f; }
+    void apply(VadIterator& vad) const {
+        if (enabled())
+            vad.set_energy_gate(std::pow(10.0f, floor_dbfs / 20.0f), warmup_windows);
+    }
+};
+
+// Reports what the energy gate saved. Run dominates the cost of a window,
+// so the ratio of windows to inferences is the expected speedup.
+static void report_gate(const gate_stats_t& stats, double elapsed) {
+    const size_t runs = stats.windows - stats.skipped + stats.warmup;
+    std::cerr << "energy gate: skipped " << stats.skipped << "/" << stats.windows << " windows ("
+              << std::fixed << std::setprecision(1)
+              << (stats.windows ? 100.0 * stats.skipped / stats.windows : 0.0) << "%), "
+              << stats.warmup << " warm-up runs, " << runs << " inferences instead of "
+              << stats.windows << " (" << std::setprecision(2)
+              << (runs ? static_cast<double>(stats.windows) / runs : 0.0) << "x), "
+              << elapsed << " s\n";
+}
+
+// Whether path ends in ext (lower case, e.g. ".wav"), ignoring case.
+static bool has_extension(const std::string& path, const std::string& ext) {
+    if (path.size() < ext.size())
+        return false;
+    std::string tail = path.substr(path.size() - ext.size());
+    std::transform(tail.begin(), tail.end(), tail.begin(), ::tolower);
+    return tail == ext;
+}
+
+// Extension of the files taken from input directories: .wav, or .vadp
+// probability tracks for --resegment.
+static std::string input_extension = ".wav";
+
+// Expands a CLI path: a directory contributes its input_extension files
+// (sorted), anything else is taken as a file.
+static void add_input_path(const std::string& path, std::vector<std::string>& wav_paths) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec)) {
+        wav_paths.push_back(path);
+        return;
+    }
+    std::vector<std::string> found;
+    for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+        if (entry.is_regular_file(ec) && has_extension(entry.path().string(), input_extension))
+            found.push_back(entry.path().string());
+    }
+    std::sort(found.begin(), found.end());
+    wav_paths.insert(wav_paths.end(), found.begin(), found.end());
+}
+
+// Output files are named after the input's stem, so two inputs with the
+// same stem would overwrite each other's. Returns false (with a message)
+// if any stem repeats.
+static bool check_unique_stems(const std::vector<std::string>& wav_paths) {
+    std::map<std::string, std::string> seen;
+    for (const auto& path : wav_paths) {
+        const std::string stem = std::filesystem::path(path).stem().string();
+        auto it = seen.emplace(stem, path);
+        if (!it.second) {
+            std::cerr << "Error: " << it.first->second << " and " << path << " would write the same "
+                      << stem << ".* output files; rename one or run them separately\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads one path per line from a list file ("-" reads stdin).
+static bool add_list_file(const std::string& list_path, std::vector<std::string>& wav_paths) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (list_path != "-") {
+        file.open(list_path);
+        if (!file) {
+            std::cerr << "Error: cannot open file list: " << list_path << "\n";
+            return false;
+        }
+        in = &file;
+    }
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty() && line[0] != '#')
+            add_input_path(line, wav_paths);
+    }
+    return true;
+}
+
+// Runs many recordings on a work-stealing pool. Each worker owns one
+// session (a VadIterator, or a VadBatchIterator when batch > 1) created
+// from the shared environment, and loads its files itself. Results go to
+// out_dir/<name>.vad.txt when out_dir is set, otherwise to stdout in input
+// order, each block preceded by "# <path>".
+static int run_files(const std::vector<std::string>& wav_paths, const std::string& model_path,
+                     int jobs, int batch, const std::string& out_dir, const GateOptions& gate,
+                     const SegmentParams& seg, const ChunkSettings& chunk, const ProbOutput& prob_out,
+                     const SegmentExport& exporter, const EngineConfig& engine) {
+    const size_t n = wav_paths.size();
+
+    // Longest files first, so stealing balances the tail of the run.
+    std::vector<size_t> order(n);
+    std::vector<uintmax_t> sizes(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        std::error_code ec;
+        order[i] = i;
+        sizes[i] = std::filesystem::file_size(wav_paths[i], ec);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    const size_t num_tasks = (n + batch - 1) / batch;
+    WorkStealingPool pool(static_cast<int>(std::min<size_t>(jobs, num_tasks)));
+    std::vector<std::unique_ptr<VadIterator>> iterators(pool.workers());
+    std::vector<std::unique_ptr<VadBatchIterator>> batch_iterators(pool.workers());
+    std::vector<std::string> results(n);
+    std::vector<char> failed(n, 0);
+    std::vector<gate_stats_t> gate_totals(pool.workers());
+
+    auto store = [&](size_t i, const std::vector<timestamp_t>& stamps) {
+        std::ostringstream out;
+        print_result(stamps, chunk, out);
+        if (out_dir.empty()) {
+            results[i] = out.str();
             return;
         }
+        std::filesystem::path dst = std::filesystem::path(out_dir) /
+            (std::filesystem::path(wav_paths[i]).stem().string() + ".vad.txt");
+        std::ofstream file(dst);
+        file << out.str();
+        if (!file) {
+            std::cerr << "Error: cannot write " << dst.string() << "\n";
+            failed[i] = 1;
+        }
+    };
 
-        // If the speech segment becomes too long.
-        if (triggered && ((current_sample - current_speech.start) > max_speech_samples)) {
-            if (prev_end > 0) {
-                current_speech.end = prev_end;
-                speeches.push_back(current_speech);
-                current_speech = timestamp_t();
-                if (next_start < prev_end)
-                    triggered = false;
-                else
-                    current_speech.start = next_start;
-                prev_end = 0;
-                next_start = 0;
-                temp_end = 0;
+    auto start = std::chrono::steady_clock::now();
+    pool.run(num_tasks, [&](size_t task, int worker) {
+        const size_t first = task * batch;
+        const size_t count = std::min<size_t>(batch, n - first);
+        try {
+            std::vector<size_t> files(count);
+            for (size_t k = 0; k < count; k++)
+                files[k] = order[first + k];
+            if (batch == 1) {
+                if (!iterators[worker]) {
+                    iterators[worker] = std::make_unique<VadIterator>(model_path, model_rate, 32, seg.threshold,
+                        seg.min_silence_ms, seg.speech_pad_ms, seg.min_speech_ms, seg.max_speech_s, engine);
+                    gate.apply(*iterators[worker]);
+                }
+                std::vector<float> probs;
+                iterators[worker]->log_probs(prob_out.enabled() ? &probs : nullptr);
+                if (run_wav(wav_paths[files[0]], *iterators[worker])) {
+                    store(files[0], iterators[worker]->get_speech_timestamps());
+                    if (prob_out.enabled() &&
+                        !prob_out.save(wav_paths[files[0]], probs, iterators[worker]->audio_length()))
+                        failed[files[0]] = 1;
+                    if (exporter.enabled() &&
+                        !exporter.write(wav_paths[files[0]], result_ranges(iterators[worker]->get_speech_timestamps(), chunk)))
+                        failed[files[0]] = 1;
+                    const gate_stats_t& g = iterators[worker]->gate_stats();
+                    gate_totals[worker].windows += g.windows;
+                    gate_totals[worker].skipped += g.skipped;
+                    gate_totals[worker].warmup += g.warmup;
+                } else {
+                    failed[files[0]] = 1;
+                }
+                return;
             }
-            else {
-                current_speech.end = current_sample;
-                speeches.push_back(current_speech);
-                current_speech = timestamp_t();
-                prev_end = 0;
-                next_start = 0;
-                temp_end = 0;
-                triggered = false;
+            std::vector<std::vector<float>> input_wavs(count);
+            for (size_t k = 0; k < count; k++) {
+                if (!load_wav(wav_paths[files[k]], input_wavs[k]))
+                    failed[files[k]] = 1;
             }
-            std::copy(new_data.end() - context_samples, new_data.end(), _context.begin());
-            return;
+            if (!batch_iterators[worker])
+                batch_iterators[worker] = std::make_unique<VadBatchIterator>(model_path, batch, model_rate, 32, seg.threshold,
+                    seg.min_silence_ms, seg.speech_pad_ms, seg.min_speech_ms, seg.max_speech_s, engine);
+            VadBatchIterator& batch_vad = *batch_iterators[worker];
+            std::vector<std::vector<float>> probs(count);
+            for (size_t k = 0; k < count; k++)
+                batch_vad.log_probs(static_cast<int>(k), prob_out.enabled() ? &probs[k] : nullptr);
+            batch_vad.process(input_wavs);
+            for (size_t k = 0; k < count; k++) {
+                batch_vad.log_probs(static_cast<int>(k), nullptr);
+                if (failed[files[k]])
+                    continue;
+                store(files[k], batch_vad.get_speech_timestamps(static_cast<int>(k)));
+                if (prob_out.enabled() && !prob_out.save(wav_paths[files[k]], probs[k], input_wavs[k].size()))
+                    failed[files[k]] = 1;
+                if (exporter.enabled() &&
+                    !exporter.write(wav_paths[files[k]], result_ranges(batch_vad.get_speech_timestamps(static_cast<int>(k)), chunk)))
+                    failed[files[k]] = 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            for (size_t k = 0; k < count; k++)
+                failed[order[first + k]] = 1;
         }
+    });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        if ((speech_prob >= (threshold - 0.15)) && (speech_prob < threshold)) {
-            // When the speech probability temporarily drops but is still in speech, update context without changing state.
-            std::copy(new_data.end() - context_samples, new_data.end(), _context.begin());
-            return;
+    size_t num_failed = 0;
+    for (size_t i = 0; i < n; i++) {
+        num_failed += failed[i];
+        if (out_dir.empty() && !failed[i]) {
+            std::cout << "# " << wav_paths[i] << "\n" << results[i];
         }
+    }
+    std::cerr << "Processed " << (n - num_failed) << "/" << n << " files in "
+              << std::fixed << std::setprecision(2) << elapsed << " s on "
+              << pool.workers() << " worker(s)\n";
+    if (gate.enabled() && batch == 1) {
+        gate_stats_t total;
+        for (const gate_stats_t& g : gate_totals) {
+            total.windows += g.windows;
+            total.skipped += g.skipped;
+            total.warmup += g.warmup;
+        }
+        report_gate(total, elapsed);
+    }
+    return num_failed == 0 ? 0 : 1;
+}
 
-        if (speech_prob < (threshold - 0.15)) {
-#ifdef __DEBUG_SPEECH_PROB___
-            float speech = current_sample - window_size_samples - speech_pad_samples;
-            printf("{ end: %.3f s (%.3f) %08d}\n", 1.0f * speech / sample_rate, speech_prob, current_sample - window_size_samples);
-#endif
-            if (triggered) {
-                if (temp_end == 0)
-                    temp_end = current_sample;
-                if (current_sample - temp_end > min_silence_samples_at_max_speech)
-                    prev_end = temp_end;
-                if ((current_sample - temp_end) >= min_silence_samples) {
-                    current_speech.end = temp_end;
-                    if (current_speech.end - current_speech.start > min_speech_samples) {
-                        speeches.push_back(current_speech);
-                        current_speech = timestamp_t();
-                        prev_end = 0;
-                        next_start = 0;
-                        temp_end = 0;
-                        triggered = false;
-                    }
-                }
+// Splits one recording into `shards` time ranges and runs them on as many
+// threads, each with its own session. A shard starts inference warmup_ms
+// before its range so the LSTM state has converged when its own windows
+// begin; probabilities of the pre-roll are discarded. The per-shard
+// probability tracks are stitched at the window boundaries and a single
+// VadSegmenter runs over the result, so segments spanning a shard boundary
+// need no merging. read(first, count, out) supplies mono samples at
+// model_rate.
+// Returns the per-window probabilities in probs.
+using SampleSource = std::function<void(size_t first, size_t count, float* out)>;
+
+static std::vector<timestamp_t> process_sharded(const SampleSource& read, size_t num_samples,
+                                                const std::string& model_path,
+                                                int shards, int warmup_ms, const SegmentParams& seg,
+                                                const EngineConfig& engine, std::vector<float>& probs) {
+    const int window_size_samples = window_samples();
+    const size_t num_windows = num_samples / window_size_samples;
+    const size_t warmup_windows = static_cast<size_t>(warmup_ms) * (model_rate / 1000) / window_size_samples;
+    shards = static_cast<int>(std::max<size_t>(1, std::min<size_t>(shards, num_windows)));
+
+    probs.assign(num_windows, 0.0f);
+    // The first shard failure is rethrown once every shard has stopped.
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    WorkStealingPool pool(shards);
+    pool.run(shards, [&](size_t k, int) {
+        try {
+            const size_t begin = num_windows * k / shards;
+            const size_t end = num_windows * (k + 1) / shards;
+            const size_t warm = begin > warmup_windows ? begin - warmup_windows : 0;
+
+            VadIterator vad(model_path, model_rate, 32, 0.5f, 100, 30, 250,
+                            std::numeric_limits<float>::infinity(), engine);
+            for (size_t w = warm; w < end; w++) {
+                read(w * window_size_samples, vad.window_size(), vad.window_input());
+                float prob = vad.infer_window();
+                if (w >= begin)
+                    probs[w] = prob;
             }
-            std::copy(new_data.end() - context_samples, new_data.end(), _context.begin());
-            return;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
         }
+    });
+    if (error)
+        std::rethrow_exception(error);
+
+    VadSegmenter segmenter = seg.segmenter();
+    for (float prob : probs)
+        segmenter.push(prob);
+    segmenter.finish(static_cast<int64_t>(num_samples));
+    return segmenter.get_speech_timestamps();
+}
+
+// How far one probability track and its segments are from a reference:
+// worst probability error, windows whose decision flipped, and boundary
+// shifts of the segments, compared pairwise when both runs found the same
+// number of them. add() pools recordings.
+struct Tolerance {
+    size_t windows = 0;
+    size_t flipped = 0;
+    float max_prob_diff = 0.0f;
+    size_t recordings = 0;
+    size_t count_mismatches = 0;   // recordings whose segment counts differ
+    size_t segments = 0;
+    size_t reference_segments = 0;
+    int64_t max_shift = 0;         // samples
+    double total_shift = 0.0;      // samples, over all compared boundaries
+    size_t boundaries = 0;
+
+    void add(const Tolerance& t) {
+        windows += t.windows;
+        flipped += t.flipped;
+        max_prob_diff = std::max(max_prob_diff, t.max_prob_diff);
+        recordings += t.recordings;
+        count_mismatches += t.count_mismatches;
+        segments += t.segments;
+        reference_segments += t.reference_segments;
+        max_shift = std::max(max_shift, t.max_shift);
+        total_shift += t.total_shift;
+        boundaries += t.boundaries;
     }
+};
 
-public:
-    // Process the entire audio input.
-    void process(const std::vector<float>& input_wav) {
-        reset_states();
-        audio_length_samples = static_cast<int>(input_wav.size());
-        // Process audio in chunks of window_size_samples (e.g., 512 samples)
-        for (size_t j = 0; j < static_cast<size_t>(audio_length_samples); j += static_cast<size_t>(window_size_samples)) {
-            if (j + static_cast<size_t>(window_size_samples) > static_cast<size_t>(audio_length_samples))
-                break;
-            std::vector<float> chunk(&input_wav[j], &input_wav[j] + window_size_samples);
-            predict(chunk);
+// A window's decision is its probability against threshold.
+static Tolerance compare_tracks(const std::vector<float>& probs, const std::vector<timestamp_t>& stamps,
+                                const std::vector<float>& reference_probs,
+                                const std::vector<timestamp_t>& reference, float threshold) {
+    Tolerance t;
+    t.recordings = 1;
+    t.windows = std::min(probs.size(), reference_probs.size());
+    for (size_t w = 0; w < t.windows; w++) {
+        t.max_prob_diff = std::max(t.max_prob_diff, std::fabs(probs[w] - reference_probs[w]));
+        t.flipped += (probs[w] >= threshold) != (reference_probs[w] >= threshold);
+    }
+    t.segments = stamps.size();
+    t.reference_segments = reference.size();
+    if (stamps.size() != reference.size()) {
+        t.count_mismatches = 1;
+        return t;
+    }
+    for (size_t i = 0; i < stamps.size(); i++) {
+        const int64_t shifts[2] = { std::abs(stamps[i].start - reference[i].start),
+                                    std::abs(stamps[i].end - reference[i].end) };
+        for (int64_t shift : shifts) {
+            t.max_shift = std::max(t.max_shift, shift);
+            t.total_shift += shift;
+            t.boundaries++;
         }
-        if (current_speech.start >= 0) {
-            current_speech.end = audio_length_samples;
-            speeches.push_back(current_speech);
-            current_speech = timestamp_t();
-            prev_end = 0;
-            next_start = 0;
-            temp_end = 0;
-            triggered = false;
+    }
+    return t;
+}
+
+// One line per comparison: "label: max prob diff ..., N/M windows flipped, ...".
+static void print_tolerance(const std::string& label, const Tolerance& t, std::ostream& out) {
+    out << label << ": max prob diff " << std::defaultfloat << std::setprecision(4) << t.max_prob_diff
+        << ", " << t.flipped << "/" << t.windows << " windows flipped, ";
+    if (t.recordings == 1 && t.count_mismatches) {
+        out << "segment count " << t.segments << " vs " << t.reference_segments << "\n";
+        return;
+    }
+    out << t.segments << " segments";
+    if (t.recordings > 1)
+        out << " (" << t.reference_segments << " in the reference), "
+            << t.count_mismatches << "/" << t.recordings << " recordings with a different count";
+    const double per_ms = model_rate / 1000.0;
+    out << ", max boundary shift " << std::fixed << std::setprecision(1) << t.max_shift / per_ms << " ms";
+    if (t.recordings > 1)
+        out << ", mean " << (t.boundaries ? t.total_shift / t.boundaries / per_ms : 0.0) << " ms";
+    out << "\n";
+}
+
+// Compares sharded output against a sequential run and reports the
+// difference on stderr.
+static void report_shard_tolerance(const SampleSource& read, size_t num_samples,
+                                   const std::string& model_path, const SegmentParams& seg,
+                                   const EngineConfig& engine,
+                                   const std::vector<float>& probs, const std::vector<timestamp_t>& stamps) {
+    const int window_size_samples = window_samples();
+
+    VadIterator vad(model_path, model_rate, 32, 0.5f, 100, 30, 250,
+                    std::numeric_limits<float>::infinity(), engine);
+    VadSegmenter segmenter = seg.segmenter();
+    std::vector<float> reference_probs(probs.size());
+    for (size_t w = 0; w < probs.size(); w++) {
+        read(w * window_size_samples, vad.window_size(), vad.window_input());
+        reference_probs[w] = vad.infer_window();
+        segmenter.push(reference_probs[w]);
+    }
+    segmenter.finish(static_cast<int64_t>(num_samples));
+    print_tolerance("sharded vs sequential",
+                    compare_tracks(probs, stamps, reference_probs, segmenter.get_speech_timestamps(), seg.threshold),
+                    std::cerr);
+}
+
+// Runs every recording through two models and reports how
+// far the second is from the first, per recording and pooled, on stdout,
+// followed by the inference time of each. This is the accuracy check for
+// a quantized model against the FP32 one, with the
+// segmentation settings of seg.
+static int compare_models(const std::vector<std::string>& wav_paths, const std::string& model_path,
+                          const std::string& compare_path, int jobs, const SegmentParams& seg,
+                          const EngineConfig& engine) {
+    const size_t n = wav_paths.size();
+    WorkStealingPool pool(static_cast<int>(std::min<size_t>(jobs, n)));
+    std::vector<std::unique_ptr<VadIterator>> references(pool.workers());
+    std::vector<std::unique_ptr<VadIterator>> candidates(pool.workers());
+    std::vector<Tolerance> results(n);
+    std::vector<char> failed(n, 0);
+    std::vector<double> reference_us(pool.workers(), 0.0), candidate_us(pool.workers(), 0.0);
+
+    pool.run(n, [&](size_t i, int worker) {
+        try {
+            if (!references[worker]) {
+                references[worker] = std::make_unique<VadIterator>(model_path, model_rate, 32, 0.5f, 100, 30, 250,
+                    std::numeric_limits<float>::infinity(), engine);
+                candidates[worker] = std::make_unique<VadIterator>(compare_path, model_rate, 32, 0.5f, 100, 30, 250,
+                    std::numeric_limits<float>::infinity(), engine);
+            }
+            VadIterator& ref = *references[worker];
+            VadIterator& cand = *candidates[worker];
+            std::vector<float> samples;
+            if (!load_wav(wav_paths[i], samples)) {
+                failed[i] = 1;
+                return;
+            }
+            const size_t window = ref.window_size();
+            const size_t num_windows = samples.size() / window;
+            std::vector<float> ref_probs(num_windows), cand_probs(num_windows);
+            VadSegmenter ref_segmenter = seg.segmenter(), cand_segmenter = seg.segmenter();
+            ref.reset();
+            cand.reset();
+            for (size_t w = 0; w < num_windows; w++) {
+                const float* chunk = samples.data() + w * window;
+                std::copy(chunk, chunk + window, ref.window_input());
+                std::copy(chunk, chunk + window, cand.window_input());
+                auto t0 = std::chrono::steady_clock::now();
+                ref_probs[w] = ref.infer_window();
+                auto t1 = std::chrono::steady_clock::now();
+                cand_probs[w] = cand.infer_window();
+                auto t2 = std::chrono::steady_clock::now();
+                reference_us[worker] += std::chrono::duration<double, std::micro>(t1 - t0).count();
+                candidate_us[worker] += std::chrono::duration<double, std::micro>(t2 - t1).count();
+                ref_segmenter.push(ref_probs[w]);
+                cand_segmenter.push(cand_probs[w]);
+            }
+            ref_segmenter.finish(static_cast<int64_t>(samples.size()));
+            cand_segmenter.finish(static_cast<int64_t>(samples.size()));
+            results[i] = compare_tracks(cand_probs, cand_segmenter.get_speech_timestamps(),
+                                        ref_probs, ref_segmenter.get_speech_timestamps(), seg.threshold);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            failed[i] = 1;
         }
+    });
+
+    Tolerance total;
+    size_t num_failed = 0;
+    for (size_t i = 0; i < n; i++) {
+        num_failed += failed[i];
+        if (failed[i])
+            continue;
+        if (n > 1)
+            print_tolerance(wav_paths[i], results[i], std::cout);
+        total.add(results[i]);
+    }
+    if (total.recordings > 0)
+        print_tolerance(compare_path + " vs " + model_path, total, std::cout);
+    double ref_total = 0.0, cand_total = 0.0;
+    for (int w = 0; w < pool.workers(); w++) {
+        ref_total += reference_us[w];
+        cand_total += candidate_us[w];
     }
+    if (total.windows > 0)
+        std::cout << "inference: " << std::fixed << std::setprecision(1)
+                  << ref_total / total.windows << " us/window vs " << cand_total / total.windows
+                  << " us/window (" << std::setprecision(2) << (cand_total > 0 ? ref_total / cand_total : 0.0)
+                  << "x)\n";
+    return num_failed == 0 ? 0 : 1;
+}
 
-    // Returns the detected speech timestamps.
-    const std::vector<timestamp_t> get_speech_timestamps() const {
-        return speeches;
-    }
-
-    // Public method to reset the internal state.
-    void reset() {
-        reset_states();
-    }
-
-public:
-    // Constructor: sets model path, sample rate, window size (ms), and other parameters.
-    // The parameters are set to match the Python version.
-    VadIterator(const std::string& ModelPath,
-        int Sample_rate = 16000, int windows_frame_size = 32,
-        float Threshold = 0.5, int min_silence_duration_ms = 100,
-        int speech_pad_ms = 30, int min_speech_duration_ms = 250,
-        float max_speech_duration_s = std::numeric_limits<float>::infinity())
-        : sample_rate(Sample_rate), threshold(Threshold), speech_pad_samples(speech_pad_ms), prev_end(0)
-    {
-        sr_per_ms = sample_rate / 1000;  // e.g., 16000 / 1000 = 16
-        window_size_samples = windows_frame_size * sr_per_ms; // e.g., 32ms * 16 = 512 samples
-        effective_window_size = window_size_samples + context_samples; // e.g., 512 + 64 = 576 samples
-        input_node_dims[0] = 1;
-        input_node_dims[1] = effective_window_size;
-        _state.resize(size_state);
-        sr.resize(1);
-        sr[0] = sample_rate;
-        _context.assign(context_samples, 0.0f);
-        min_speech_samples = sr_per_ms * min_speech_duration_ms;
-        max_speech_samples = (sample_rate * max_speech_duration_s - window_size_samples - 2 * speech_pad_samples);
-        min_silence_samples = sr_per_ms * min_silence_duration_ms;
-        min_silence_samples_at_max_speech = sr_per_ms * 98;
-        init_onnx_model(ModelPath);
+// Re-runs segmentation over probability tracks saved with --save-probs,
+// with the current segmentation parameters and no model. Output is as for
+// the recordings themselves.
+static int resegment_files(const std::vector<std::string>& track_paths, const SegmentParams& seg,
+                           const ChunkSettings& chunk) {
+    size_t num_failed = 0;
+    size_t windows = 0;
+    double audio_s = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& path : track_paths) {
+        ProbTrack track;
+        try {
+            track.load(path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            num_failed++;
+            continue;
+        }
+        VadSegmenter segmenter = seg.segmenter(track.sample_rate, track.window_samples * 1000 / track.sample_rate);
+        if (track_paths.size() > 1)
+            std::cout << "# " << path << "\n";
+        print_result(track.segment(segmenter), chunk, std::cout, track.sample_rate);
+        windows += track.probs.size();
+        audio_s += static_cast<double>(track.audio_samples) / track.sample_rate;
     }
-};
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Resegmented " << (track_paths.size() - num_failed) << "/" << track_paths.size()
+              << " tracks (" << windows << " windows, " << std::fixed << std::setprecision(1) << audio_s
+              << " s of audio) in " << std::setprecision(3) << elapsed << " s ("
+              << std::setprecision(0) << (elapsed > 0 ? audio_s / elapsed : 0.0) << "x real time)\n";
+    return num_failed == 0 ? 0 : 1;
+}
 
-// takes .wav as argument
+static void usage() {
+    std::cerr << "Usage: ./vad [options] <audio.wav|dir> [more ...]\n"
+              << "  -j N, --jobs=N    worker threads for several files (default: all cores)\n"
+              << "  --batch=N         streams per inference call in each worker (default: 1)\n"
+              << "  --list=FILE       read input paths from FILE, one per line (- for stdin)\n"
+              << "  --out-dir=DIR     write <name>.vad.txt per file instead of stdout\n"
+              << "  --shards=K        split a single file into K time shards run in parallel\n"
+              << "  --warmup-ms=N     pre-roll each shard starts early by (default: 2000)\n"
+              << "  --verify          also run sequentially and report the sharding error\n"
+              << "  --sample-rate=HZ  run the model at 16000 (default) or 8000 Hz; input is\n"
+              << "                    converted to it, so 8 kHz audio is used as it is\n"
+              << "  --model=PATH      ONNX model\n"
+              << "                    (default: " << MODEL_PATH << ")\n"
+              << "  --int8            use the INT8 variant of the model (<name>.int8.onnx,\n"
+              << "                    made by tools/quantize_model.py)\n"
+              << "  --compare=PATH    run the inputs through the model and PATH and report\n"
+              << "                    how far PATH's probabilities and segments differ\n"
+              << "  --threshold=P     speech probability that opens a segment (default: 0.5)\n"
+              << "  --min-silence-ms=N\n"
+              << "                    silence that closes a segment (default: 100)\n"
+              << "  --min-speech-ms=N shortest segment kept (default: 250)\n"
+              << "  --max-speech-s=S  split segments longer than S (default: no limit)\n"
+              << "  --speech-pad-ms=N padding reserved within --max-speech-s (default: 30)\n"
+              << "  --save-probs=DIR  also write each input's per-window probabilities to\n"
+              << "                    DIR/<name>.vadp\n"
+              << "  --prob-bits=8|16  precision of --save-probs tracks (default: 16)\n"
+              << "  --resegment       inputs are .vadp tracks: segment them again with the\n"
+              << "                    options above, without running the model\n"
+              << "  --export=DIR      write the audio of each segment (or chunk) to\n"
+              << "                    DIR/<name>_0001.wav, ... as mono 16-bit at --sample-rate\n"
+              << "  --export-concat   with --export: one DIR/<name>.speech.wav per input, with a\n"
+              << "                    cue point at the start of each segment\n"
+              << "  --chunk           merge and cut segments into chunks for transcription and\n"
+              << "                    print them as \"<start> to <end>\" seconds\n"
+              << "  --micro-pause=S   join segments closer than S (default: 0.15; implies --chunk)\n"
+              << "  --long-break=S    always cut at gaps longer than S (default: 5.0)\n"
+              << "  --max-seg=S       cut chunks reaching S at their widest gap (default: 30.0,\n"
+              << "                    0 = no limit)\n"
+              << "  --energy-gate=DB  skip inference on windows quieter than DB dBFS (e.g. -50)\n"
+              << "  --gate-warmup=N   skipped windows re-run when inference resumes (default: 8)\n"
+              << "  --tune            use the cached ONNX Runtime threading tuned for this\n"
+              << "                    machine and model, tuning it first if needed\n"
+              << "  --retune          tune again and replace the cached settings\n"
+              << "  --prepare         build the optimized model cache (and tuning, with\n"
+              << "                    --tune) and exit\n";
+}
+
+// takes one or more .wav files, directories or file lists as arguments
 int main(int argc, char** argv) {
     // -------------------------
     // Handle CLI argument
     // -------------------------
-    std::string wav_path = "audio/recorder.wav"; // default
+    std::vector<std::string> wav_paths;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    int batch = 1;
+    std::string out_dir;
+    int shards = 1;
+    int warmup_ms = 2000;
+    bool verify = false;
+    GateOptions gate;
+    ChunkSettings chunk;
+    bool tune = false;
+    bool retune = false;
+    bool prepare = false;
+    std::string model_path = MODEL_PATH;
+    std::string compare_path;
+    bool int8 = false;
+    SegmentParams seg;
+    ProbOutput prob_out;
+    SegmentExport exporter;
+    bool resegment = false;
 
-    if (argc > 1) {
-        wav_path = argv[1];
-    } else {
-        std::cerr << "Usage: ./vad <audio.wav>\n"
-                  << "No file given, defaulting to: " << wav_path << "\n";
+    // Directories and lists are expanded while parsing, so the input kind
+    // has to be known first.
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--resegment")
+            input_extension = ".vadp";
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-h" || a == "--help") {
+            usage();
+            return 0;
+        } else if (a == "-j" && i + 1 < argc) {
+            jobs = std::max(1, std::atoi(argv[++i]));
+        } else if (a.rfind("--jobs=", 0) == 0) {
+            jobs = std::max(1, std::atoi(a.c_str() + 7));
+        } else if (a.rfind("--batch=", 0) == 0) {
+            batch = std::max(1, std::atoi(a.c_str() + 8));
+        } else if (a.rfind("--list=", 0) == 0) {
+            if (!add_list_file(a.substr(7), wav_paths))
+                return 1;
+        } else if (a.rfind("--out-dir=", 0) == 0) {
+            out_dir = a.substr(10);
+        } else if (a.rfind("--shards=", 0) == 0) {
+            shards = std::max(1, std::atoi(a.c_str() + 9));
+        } else if (a.rfind("--warmup-ms=", 0) == 0) {
+            warmup_ms = std::max(0, std::atoi(a.c_str() + 12));
+        } else if (a == "--verify") {
+            verify = true;
+        } else if (a == "--tune") {
+            tune = true;
+        } else if (a == "--retune") {
+            tune = retune = true;
+        } else if (a.rfind("--sample-rate=", 0) == 0) {
+            model_rate = std::atoi(a.c_str() + 14);
+            if (model_rate != 16000 && model_rate != 8000) {
+                std::cerr << "Error: --sample-rate must be 16000 or 8000\n";
+                return 1;
+            }
+        } else if (a.rfind("--model=", 0) == 0) {
+            model_path = a.substr(8);
+        } else if (a == "--int8") {
+            int8 = true;
+        } else if (a.rfind("--compare=", 0) == 0) {
+            compare_path = a.substr(10);
+        } else if (a == "--prepare") {
+            prepare = true;
+        } else if (a.rfind("--energy-gate=", 0) == 0) {
+            gate.floor_dbfs = static_cast<float>(std::atof(a.c_str() + 14));
+        } else if (a.rfind("--gate-warmup=", 0) == 0) {
+            gate.warmup_windows = std::max(0, std::atoi(a.c_str() + 14));
+        } else if (a == "--chunk") {
+            chunk.enabled = true;
+        } else if (a.rfind("--micro-pause=", 0) == 0) {
+            chunk.enabled = true;
+            chunk.options.micro_pause = std::max(0.0, std::atof(a.c_str() + 14));
+        } else if (a.rfind("--long-break=", 0) == 0) {
+            chunk.enabled = true;
+            chunk.options.long_break = std::max(0.0, std::atof(a.c_str() + 13));
+        } else if (a.rfind("--max-seg=", 0) == 0) {
+            chunk.enabled = true;
+            chunk.options.max_seg = std::max(0.0, std::atof(a.c_str() + 10));
+        } else if (a.rfind("--threshold=", 0) == 0) {
+            seg.threshold = static_cast<float>(std::atof(a.c_str() + 12));
+        } else if (a.rfind("--min-silence-ms=", 0) == 0) {
+            seg.min_silence_ms = std::max(0, std::atoi(a.c_str() + 17));
+        } else if (a.rfind("--speech-pad-ms=", 0) == 0) {
+            seg.speech_pad_ms = std::max(0, std::atoi(a.c_str() + 16));
+        } else if (a.rfind("--min-speech-ms=", 0) == 0) {
+            seg.min_speech_ms = std::max(0, std::atoi(a.c_str() + 16));
+        } else if (a.rfind("--max-speech-s=", 0) == 0) {
+            const float s = static_cast<float>(std::atof(a.c_str() + 15));
+            seg.max_speech_s = s > 0.0f ? s : std::numeric_limits<float>::infinity();
+        } else if (a.rfind("--save-probs=", 0) == 0) {
+            prob_out.dir = a.substr(13);
+        } else if (a.rfind("--prob-bits=", 0) == 0) {
+            prob_out.bits = std::atoi(a.c_str() + 12) == 8 ? 8 : 16;
+        } else if (a == "--resegment") {
+            resegment = true;
+        } else if (a.rfind("--export=", 0) == 0) {
+            exporter.dir = a.substr(9);
+        } else if (a == "--export-concat") {
+            exporter.concat = true;
+        } else if (a.rfind("--", 0) == 0) {
+            std::cerr << "Unknown arg: " << a << "\n";
+            usage();
+            return 1;
+        } else {
+            add_input_path(a, wav_paths);
+        }
+    }
+    if (wav_paths.empty() && !prepare) {
+        wav_paths.push_back("audio/recorder.wav"); // default
+        usage();
+        std::cerr << "No file given, defaulting to: " << wav_paths[0] << "\n";
+    }
+    if (!resegment && (!out_dir.empty() || prob_out.enabled() || exporter.enabled()) &&
+        !check_unique_stems(wav_paths))
+        return 1;
+    if (!out_dir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(out_dir, ec);
+    }
+    if (prob_out.enabled()) {
+        std::error_code ec;
+        std::filesystem::create_directories(prob_out.dir, ec);
+        // Which windows the gate skips depends on this run's segmentation
+        // settings; a track replayed with others needs every probability.
+        if (gate.enabled()) {
+            std::cerr << "Note: --save-probs needs every window's probability; --energy-gate ignored\n";
+            gate.floor_dbfs = 0.0f;
+        }
+    }
+    if (exporter.concat && !exporter.enabled()) {
+        std::cerr << "Error: --export-concat needs --export=DIR\n";
+        return 1;
+    }
+    if (exporter.enabled()) {
+        std::error_code ec;
+        std::filesystem::create_directories(exporter.dir, ec);
     }
 
     // -------------------------
-    // Load WAV file
+    // Stored probability tracks: segmentation only, no model
     // -------------------------
-    wav::WavReader wav_reader(wav_path.c_str());
-    int numSamples = wav_reader.num_samples();
+    if (resegment) {
+        if (exporter.enabled())
+            std::cerr << "Note: --export needs the audio, not probability tracks; ignored\n";
+        return resegment_files(wav_paths, seg, chunk);
+    }
 
-    if (numSamples == 0) {
-        std::cerr << "Error: WAV file has zero samples or failed to load: "
-                  << wav_path << "\n";
-        return 1;
+    if (int8) {
+        if (model_rate != 16000) {
+            std::cerr << "Error: the INT8 model serves 16 kHz only\n";
+            return 1;
+        }
+        model_path = int8_model_path(model_path);
+        if (!is_regular_file(model_path)) {
+            std::cerr << "Error: no INT8 model at " << model_path
+                      << "; create it with tools/quantize_model.py\n";
+            return 1;
+        }
     }
 
-    std::vector<float> input_wav(static_cast<size_t>(numSamples));
-    for (size_t i = 0; i < static_cast<size_t>(numSamples); i++) {
-        input_wav[i] = static_cast<float>(*(wav_reader.data() + i));
+    // ONNX Runtime threading: one intra-op thread per session unless tuned.
+    // The tuner gets the cores left per session by the parallel workers,
+    // and the batch size those sessions run.
+    EngineConfig engine;
+    if (tune) {
+        const bool many = wav_paths.size() > 1 || !out_dir.empty();
+        const int sessions = many ? jobs : shards;
+        const int cores = std::max(1u, std::thread::hardware_concurrency());
+        try {
+            engine = auto_engine_config(model_path, std::max(1, cores / sessions), retune, model_rate,
+                                        many ? batch : 1);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: engine tuning failed: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    // Creating a session writes the optimized model cache; nothing else to do.
+    if (prepare) {
+        try {
+            VadIterator vad(model_path, model_rate, 32, 0.5f, 100, 30, 250,
+                            std::numeric_limits<float>::infinity(), engine);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        if (model_cache_enabled())
+            std::cerr << "Model cache ready: " << optimized_model_path(model_path) << "\n";
+        else
+            std::cerr << "Model cache disabled (SILERO_VAD_MODEL_CACHE=0)\n";
+        return 0;
     }
 
     // -------------------------
-    // Load ONNX model
+    // Accuracy of another model against this one
     // -------------------------
-    std::string model_path = MODEL_PATH;
-    VadIterator vad(model_path);
+    if (!compare_path.empty())
+        return compare_models(wav_paths, model_path, compare_path, jobs, seg, engine);
 
     // -------------------------
-    // Process audio
+    // Several files (or per-file output): worker pool
     // -------------------------
-    vad.process(input_wav);
+    if (wav_paths.size() > 1 || !out_dir.empty()) {
+        if (shards > 1)
+            std::cerr << "Note: --shards applies to a single file on stdout; ignored\n";
+        if (gate.enabled() && batch > 1)
+            std::cerr << "Note: --energy-gate does not apply to --batch; ignored\n";
+        return run_files(wav_paths, model_path, jobs, batch, out_dir, gate, seg, chunk, prob_out, exporter, engine);
+    }
 
     // -------------------------
-    // Output timestamps
+    // Single file: one stream, decoded block by block
     // -------------------------
-    std::vector<timestamp_t> stamps = vad.get_speech_timestamps();
-    const float sample_rate_float = 16000.0f;
+#ifndef __COUNT_ALLOCS___
+    if (shards == 1) {
+        VadIterator vad(model_path, model_rate, 32, seg.threshold, seg.min_silence_ms, seg.speech_pad_ms,
+                        seg.min_speech_ms, seg.max_speech_s, engine);
+        gate.apply(vad);
+        std::vector<float> probs;
+        vad.log_probs(prob_out.enabled() ? &probs : nullptr);
+        auto start = std::chrono::steady_clock::now();
+        if (!run_wav(wav_paths[0], vad))
+            return 1;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        print_result(vad.get_speech_timestamps(), chunk);
+        if (gate.enabled())
+            report_gate(vad.gate_stats(), elapsed);
+        if (prob_out.enabled() && !prob_out.save(wav_paths[0], probs, vad.audio_length()))
+            return 1;
+        if (exporter.enabled() && !exporter.write(wav_paths[0], result_ranges(vad.get_speech_timestamps(), chunk)))
+            return 1;
+        return 0;
+    }
+#endif
+    if (gate.enabled() && shards > 1)
+        std::cerr << "Note: --energy-gate does not apply to --shards; ignored\n";
 
-    for (size_t i = 0; i < stamps.size(); i++) {
-        float start_sec = std::rint((stamps[i].start / sample_rate_float) * 10.0f) / 10.0f;
-        float end_sec = std::rint((stamps[i].end  / sample_rate_float) * 10.0f) / 10.0f;
-        std::cout << "Speech detected from "
-                  << std::fixed << std::setprecision(1) << start_sec
-                  << " s to "
-                  << std::fixed << std::setprecision(1) << end_sec << " s\n";
+    // Sharding reads the mapped file at each shard's offset; other rates
+    // and multichannel files are converted to mono at model_rate up front.
+    if (shards > 1) {
+        wav::WavMmapReader reader;
+        if (!reader.Open(wav_paths[0]) || reader.num_samples() == 0) {
+            std::cerr << "Error: --shards needs a regular, non-empty WAV file: "
+                      << wav_paths[0] << "\n";
+            return 1;
+        }
+        std::vector<float> converted;
+        SampleSource read = [&reader](size_t first, size_t count, float* out) {
+            reader.Convert(first, count, out);
+        };
+        size_t num_samples = reader.num_samples();
+        if (reader.sample_rate() != model_rate || reader.num_channel() != 1) {
+            decode_mono(reader, converted);
+            read = [&converted](size_t first, size_t count, float* out) {
+                std::copy(converted.begin() + first, converted.begin() + first + count, out);
+            };
+            num_samples = converted.size();
+        }
+        std::vector<float> probs;
+        std::vector<timestamp_t> stamps;
+        try {
+            stamps = process_sharded(read, num_samples, model_path, shards, warmup_ms, seg, engine, probs);
+            print_result(stamps, chunk);
+            if (verify)
+                report_shard_tolerance(read, num_samples, model_path, seg, engine, probs, stamps);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        if (prob_out.enabled() && !prob_out.save(wav_paths[0], probs, num_samples))
+            return 1;
+        if (exporter.enabled() && !exporter.write(wav_paths[0], result_ranges(stamps, chunk)))
+            return 1;
+        return 0;
     }
 
+    // The allocation check needs the whole recording in memory.
+    std::vector<float> input_wav;
+    if (!load_wav(wav_paths[0], input_wav))
+        return 1;
+
+    VadIterator vad(model_path, model_rate, 32, seg.threshold, seg.min_silence_ms, seg.speech_pad_ms,
+                    seg.min_speech_ms, seg.max_speech_s, engine);
+    gate.apply(vad);
+    vad.process(input_wav);
+    print_result(vad.get_speech_timestamps(), chunk);
+#ifdef __COUNT_ALLOCS___
+    // The first pass was the warm-up; a second pass over the same audio
+    // must not allocate outside of ONNX Runtime.
+    unsigned long total0 = alloc_stats::total(), run0 = alloc_stats::in_run();
+    vad.process(input_wav);
+    unsigned long run = alloc_stats::in_run() - run0;
+    unsigned long own = alloc_stats::total() - total0 - run;
+    std::cerr << "steady-state allocations over " << input_wav.size() / window_samples() << " chunks: "
+              << own << " in vad, " << run << " inside session->Run\n";
+    if (own != 0)
+        return 2;
+#endif
     vad.reset();
     return 0;
 }
-
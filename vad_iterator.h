@@ -0,0 +1,839 @@
+#ifndef VAD_ITERATOR_H_
+#define VAD_ITERATOR_H_
+
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdarg>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#if __cplusplus < 201703L
+#include <memory>
+#endif
+
+//#define __DEBUG_SPEECH_PROB___
+//#define __COUNT_ALLOCS___
+
+#include "onnxruntime_cxx_api.h"
+#include "ort_setup.h" // create_vad_session(), EngineConfig
+#include "frontend.h" // frontend::dot_product for the energy gate
+
+// timestamp_t class: stores the start and end (in samples) of a speech segment.
+// Positions are 64-bit so that a live stream can run for as long as it is fed.
+class timestamp_t {
+public:
+    int64_t start;
+    int64_t end;
+
+    timestamp_t(int64_t start = -1, int64_t end = -1)
+        : start(start), end(end) { }
+
+    bool operator==(const timestamp_t& a) const {
+        return (start == a.start && end == a.end);
+    }
+
+    // Returns a formatted string of the timestamp.
+    std::string c_str() const {
+        return format("{start:%08lld, end:%08lld}", static_cast<long long>(start), static_cast<long long>(end));
+    }
+private:
+    // Helper function for formatting.
+    std::string format(const char* fmt, ...) const {
+        char buf[256];
+        va_list args;
+        va_start(args, fmt);
+        const auto r = std::vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        if (r < 0)
+            return {};
+        const size_t len = r;
+        if (len < sizeof(buf))
+            return std::string(buf, len);
+#if __cplusplus >= 201703L
+        std::string s(len, '\0');
+        va_start(args, fmt);
+        std::vsnprintf(s.data(), len + 1, fmt, args);
+        va_end(args);
+        return s;
+#else
+        auto vbuf = std::unique_ptr<char[]>(new char[len + 1]);
+        va_start(args, fmt);
+        std::vsnprintf(vbuf.get(), len + 1, fmt, args);
+        va_end(args);
+        return std::string(vbuf.get(), len);
+#endif
+    }
+};
+
+// VadSegmenter class: the trigger state machine that turns per-window speech
+// probabilities into speech timestamps. It holds no ONNX Runtime state, so
+// one instance can be kept per stream when several streams share a session.
+class VadSegmenter {
+private:
+    // Model configuration parameters
+    int sample_rate;
+    int window_size_samples;
+    float threshold;
+    int min_silence_samples;
+    int min_silence_samples_at_max_speech;
+    int min_speech_samples;
+    float max_speech_samples;
+    int speech_pad_samples;
+
+    // State management
+    bool triggered = false;
+    int64_t temp_end = 0;
+    int64_t current_sample = 0;
+    int64_t prev_end;
+    int64_t next_start = 0;
+    std::vector<timestamp_t> speeches;
+    timestamp_t current_speech;
+
+public:
+    VadSegmenter(int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 100,
+        int speech_pad_ms = 30, int min_speech_duration_ms = 250,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity())
+        : sample_rate(Sample_rate), threshold(Threshold), speech_pad_samples(speech_pad_ms), prev_end(0)
+    {
+        int sr_per_ms = sample_rate / 1000;  // e.g., 16000 / 1000 = 16
+        window_size_samples = windows_frame_size * sr_per_ms; // e.g., 32ms * 16 = 512 samples
+        min_speech_samples = sr_per_ms * min_speech_duration_ms;
+        max_speech_samples = (sample_rate * max_speech_duration_s - window_size_samples - 2 * speech_pad_samples);
+        min_silence_samples = sr_per_ms * min_silence_duration_ms;
+        min_silence_samples_at_max_speech = sr_per_ms * 98;
+    }
+
+    // Resets the trigger state and drops collected timestamps.
+    void reset() {
+        triggered = false;
+        temp_end = 0;
+        current_sample = 0;
+        prev_end = next_start = 0;
+        speeches.clear();
+        current_speech = timestamp_t();
+    }
+
+    // Advances the state machine by one window with the given speech probability.
+    void push(float speech_prob) {
+        current_sample += window_size_samples; // Advance by the original window size.
+
+        // If speech is detected (probability >= threshold)
+        if (speech_prob >= threshold) {
+#ifdef __DEBUG_SPEECH_PROB___
+            float speech = current_sample - window_size_samples;
+            printf("{ start: %.3f s (%.3f) %08lld}\n", 1.0f * speech / sample_rate, speech_prob, static_cast<long long>(current_sample - window_size_samples));
+#endif
+            if (temp_end != 0) {
+                temp_end = 0;
+                if (next_start < prev_end)
+                    next_start = current_sample - window_size_samples;
+            }
+            if (!triggered) {
+                triggered = true;
+                current_speech.start = current_sample - window_size_samples;
+            }
+            return;
+        }
+
+        // If the speech segment becomes too long.
+        if (triggered && ((current_sample - current_speech.start) > max_speech_samples)) {
+            if (prev_end > 0) {
+                current_speech.end = prev_end;
+                speeches.push_back(current_speech);
+                current_speech = timestamp_t();
+                if (next_start < prev_end)
+                    triggered = false;
+                else
+                    current_speech.start = next_start;
+                prev_end = 0;
+                next_start = 0;
+                temp_end = 0;
+            }
+            else {
+                current_speech.end = current_sample;
+                speeches.push_back(current_speech);
+                current_speech = timestamp_t();
+                prev_end = 0;
+                next_start = 0;
+                temp_end = 0;
+                triggered = false;
+            }
+            return;
+        }
+
+        if ((speech_prob >= (threshold - 0.15)) && (speech_prob < threshold)) {
+            // When the speech probability temporarily drops but is still in speech, keep the state unchanged.
+            return;
+        }
+
+        if (speech_prob < (threshold - 0.15)) {
+#ifdef __DEBUG_SPEECH_PROB___
+            float speech = current_sample - window_size_samples - speech_pad_samples;
+            printf("{ end: %.3f s (%.3f) %08lld}\n", 1.0f * speech / sample_rate, speech_prob, static_cast<long long>(current_sample - window_size_samples));
+#endif
+            if (triggered) {
+                if (temp_end == 0)
+                    temp_end = current_sample;
+                if (current_sample - temp_end > min_silence_samples_at_max_speech)
+                    prev_end = temp_end;
+                if ((current_sample - temp_end) >= min_silence_samples) {
+                    current_speech.end = temp_end;
+                    if (current_speech.end - current_speech.start > min_speech_samples) {
+                        speeches.push_back(current_speech);
+                        current_speech = timestamp_t();
+                        prev_end = 0;
+                        next_start = 0;
+                        temp_end = 0;
+                        triggered = false;
+                    }
+                }
+            }
+            return;
+        }
+    }
+
+    // Closes a segment that is still open at the end of the audio.
+    void finish(int64_t audio_length_samples) {
+        if (current_speech.start >= 0) {
+            current_speech.end = audio_length_samples;
+            speeches.push_back(current_speech);
+            current_speech = timestamp_t();
+            prev_end = 0;
+            next_start = 0;
+            temp_end = 0;
+            triggered = false;
+        }
+    }
+
+    bool is_triggered() const { return triggered; }
+    int64_t get_current_start() const { return current_speech.start; }
+
+    // Returns the detected speech timestamps.
+    const std::vector<timestamp_t>& get_speech_timestamps() const {
+        return speeches;
+    }
+
+    // Drops the first n collected timestamps, once a streaming caller has
+    // taken them; the trigger state is not touched.
+    void drop_speeches(size_t n) {
+        speeches.erase(speeches.begin(), speeches.begin() + std::min(n, speeches.size()));
+    }
+};
+
+#ifdef __COUNT_ALLOCS___
+// Heap allocation tally for the zero-allocation check in vad.cpp, which
+// replaces operator new to fill it. Allocations made while ONNX Runtime is
+// inside session->Run are counted separately: they belong to the runtime,
+// not to the per-chunk path of this file.
+struct alloc_stats {
+    static std::atomic<unsigned long>& total() { static std::atomic<unsigned long> n{0}; return n; }
+    static std::atomic<unsigned long>& in_run() { static std::atomic<unsigned long> n{0}; return n; }
+    static bool& running() { static thread_local bool r = false; return r; }
+
+    // Marks the enclosing scope as ONNX Runtime work.
+    struct run_scope {
+        run_scope() { running() = true; }
+        ~run_scope() { running() = false; }
+    };
+};
+#endif
+
+// Counters of the energy pre-gate (see VadIterator::set_energy_gate).
+struct gate_stats_t {
+    size_t windows = 0;   // windows that went through the gate
+    size_t skipped = 0;   // windows below the floor, not run
+    size_t warmup = 0;    // extra inferences re-running skipped windows
+};
+
+// VadIterator class: uses ONNX Runtime to detect speech segments.
+// All tensors are bound once over persistent buffers, so predict() does not
+// allocate once the session is loaded.
+class VadIterator {
+private:
+    // ONNX Runtime resources
+    Ort::SessionOptions session_options;
+    std::shared_ptr<Ort::Session> session = nullptr;
+    Ort::AllocatorWithDefaultOptions allocator;
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+    Ort::RunOptions run_options{ nullptr };
+
+    // ----- Context-related additions -----
+    // For 16kHz, 64 samples are added as context (32 for 8kHz; see
+    // context_samples_for()). The context lives in place at the front of
+    // `input`: after each chunk its last context_samples are moved to the
+    // front and the next chunk is written right behind them.
+    int context_samples = 64;
+
+    // Original window size (e.g., 32ms corresponds to 512 samples)
+    int window_size_samples;
+    // Effective window size = window_size_samples + context_samples
+    int effective_window_size;
+
+    // Additional declaration: samples per millisecond
+    int sr_per_ms;
+
+    // ONNX Runtime input/output buffers. The state is double buffered: Run
+    // reads _state[cur] and writes stateN into _state[cur ^ 1], then cur
+    // flips, so no state copy is needed. ort_inputs[k]/ort_outputs[k] are
+    // the tensor sets for cur == k.
+    std::vector<Ort::Value> ort_inputs[2];
+    std::vector<const char*> input_node_names = { "input", "state", "sr" };
+    std::vector<float> input;
+    unsigned int size_state = 2 * 1 * 128;
+    std::vector<float> _state[2];
+    int cur = 0;
+    std::vector<int64_t> sr;
+    int64_t input_node_dims[2] = {};
+    const int64_t state_node_dims[3] = { 2, 1, 128 };
+    const int64_t sr_node_dims[1] = { 1 };
+    const int64_t output_node_dims[2] = { 1, 1 };
+    float speech_prob_out = 0.0f;
+    std::vector<Ort::Value> ort_outputs[2];
+    std::vector<const char*> output_node_names = { "output", "stateN" };
+
+    int sample_rate;
+    int64_t audio_length_samples = 0;
+
+    // Streaming feed: samples of the window being filled, written straight
+    // into input behind the context.
+    int pending_samples = 0;
+
+    // Speech trigger state machine
+    VadSegmenter segmenter;
+
+    // ----- Energy pre-gate -----
+    // Windows quieter than gate_floor (RMS) are not run and count as
+    // non-speech. The full inputs of the last gate_warmup skipped windows,
+    // context included, are kept in a ring so the state can be rebuilt by
+    // re-running them once a louder window arrives.
+    float gate_floor = 0.0f;         // 0 disables the gate
+    int gate_warmup = 0;
+    std::vector<float> gate_history; // [gate_warmup][effective_window_size]
+    std::vector<float> gate_saved;   // the loud window, kept aside during warm-up
+    int gate_head = 0;               // ring slot for the next skipped window
+    int gate_run = 0;                // windows skipped since the last inference
+    gate_stats_t gate_counters;
+
+    // Probabilities of the segmented windows are appended here when set
+    std::vector<float>* prob_log = nullptr;
+
+    // Loads the ONNX model.
+    void init_onnx_model(const std::string& model_path, const EngineConfig& engine) {
+        session = create_vad_session(model_path, engine, session_options);
+    }
+
+    // Sizes the persistent buffers for the window and binds the tensors.
+    void init_buffers(int windows_frame_size) {
+        context_samples = context_samples_for(sample_rate);
+        sr_per_ms = sample_rate / 1000;  // e.g., 16000 / 1000 = 16
+        window_size_samples = windows_frame_size * sr_per_ms; // e.g., 32ms * 16 = 512 samples
+        effective_window_size = window_size_samples + context_samples; // e.g., 512 + 64 = 576 samples
+        input_node_dims[0] = 1;
+        input_node_dims[1] = effective_window_size;
+        input.assign(effective_window_size, 0.0f);
+        _state[0].assign(size_state, 0.0f);
+        _state[1].assign(size_state, 0.0f);
+        sr.resize(1);
+        sr[0] = sample_rate;
+        bind_tensors();
+    }
+
+    // Creates the input/output tensors over the persistent buffers.
+    void bind_tensors() {
+        for (int k = 0; k < 2; k++) {
+            ort_inputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, input.data(), input.size(), input_node_dims, 2));
+            ort_inputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, _state[k].data(), _state[k].size(), state_node_dims, 3));
+            ort_inputs[k].emplace_back(Ort::Value::CreateTensor<int64_t>(
+                memory_info, sr.data(), sr.size(), sr_node_dims, 1));
+            ort_outputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, &speech_prob_out, 1, output_node_dims, 2));
+            ort_outputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, _state[k ^ 1].data(), _state[k ^ 1].size(), state_node_dims, 3));
+        }
+    }
+
+    // Resets internal state (_state, context, etc.)
+    void reset_states() {
+        std::fill(_state[0].begin(), _state[0].end(), 0.0f);
+        std::fill(_state[1].begin(), _state[1].end(), 0.0f);
+        cur = 0;
+        segmenter.reset();
+        std::fill(input.begin(), input.begin() + context_samples, 0.0f);
+        audio_length_samples = 0;
+        pending_samples = 0;
+        gate_head = 0;
+        gate_run = 0;
+        gate_counters = gate_stats_t();
+    }
+
+    // Runs the network on the window already in place in input.
+    float infer_in_place() {
+        {
+#ifdef __COUNT_ALLOCS___
+            alloc_stats::run_scope scope;
+#endif
+            session->Run(run_options,
+                input_node_names.data(), ort_inputs[cur].data(), ort_inputs[cur].size(),
+                output_node_names.data(), ort_outputs[cur].data(), ort_outputs[cur].size());
+        }
+        cur ^= 1;
+
+        // Update context: move the last context_samples of this window to the front.
+        std::copy(input.end() - context_samples, input.end(), input.begin());
+        return speech_prob_out;
+    }
+
+    // Re-runs the windows skipped since the last inference, oldest first,
+    // before the window in input. A gap that fits in the ring continues
+    // from the state it left off with and is reproduced exactly; a longer
+    // one starts from a zero state and relies on the warm-up to converge.
+    void gate_rewarm() {
+        const int replay = std::min(gate_run, gate_warmup);
+        if (gate_run > gate_warmup)
+            std::fill(_state[cur].begin(), _state[cur].end(), 0.0f);
+        std::copy(input.begin(), input.end(), gate_saved.begin());
+        for (int k = replay; k > 0; k--) {
+            const int slot = (gate_head - k + gate_warmup) % gate_warmup;
+            const float* src = gate_history.data() + static_cast<size_t>(slot) * effective_window_size;
+            std::copy(src, src + effective_window_size, input.begin());
+            infer_in_place();
+        }
+        std::copy(gate_saved.begin(), gate_saved.end(), input.begin());
+        gate_counters.warmup += replay;
+        gate_run = 0;
+    }
+
+    // Speech probability of the window in place in input, through the
+    // energy gate when it is enabled and no probability log is attached.
+    // While a segment is open every window is run, so segment ends are
+    // still decided by the model.
+    float gated_infer_in_place() {
+        if (gate_floor <= 0.0f)
+            return infer_in_place();
+        if (prob_log) {
+            if (gate_run > 0)
+                gate_rewarm();
+            return infer_in_place();
+        }
+        gate_counters.windows++;
+        const float* window = input.data() + context_samples;
+        const float energy = frontend::dot_product(window, window, window_size_samples);
+        if (energy < gate_floor * gate_floor * window_size_samples && !segmenter.is_triggered()) {
+            if (gate_warmup > 0) {
+                std::copy(input.begin(), input.end(),
+                          gate_history.begin() + static_cast<size_t>(gate_head) * effective_window_size);
+                gate_head = (gate_head + 1) % gate_warmup;
+            }
+            gate_run++;
+            gate_counters.skipped++;
+            std::copy(input.end() - context_samples, input.end(), input.begin());
+            return 0.0f;
+        }
+        if (gate_run > 0)
+            gate_rewarm();
+        return infer_in_place();
+    }
+
+    // One inference on silence, so ORT's lazy initialisation is paid here
+    // rather than by the first real chunk.
+    void warm_up() {
+        std::fill(input.begin(), input.end(), 0.0f);
+        infer_in_place();
+        reset_states();
+    }
+
+    // Runs the window in place in input and advances the trigger state
+    // machine with its probability.
+    void segment_in_place() {
+        const float prob = gated_infer_in_place();
+        if (prob_log)
+            prob_log->push_back(prob);
+        segmenter.push(prob);
+    }
+
+    // Inference plus trigger state machine for one chunk.
+    void predict(const float* data_chunk) {
+        std::copy(data_chunk, data_chunk + window_size_samples, input.begin() + context_samples);
+        segment_in_place();
+    }
+
+public:
+    // Inference: runs inference on one chunk of input data and returns its
+    // speech probability. _state and the context carry over to the next
+    // chunk; the trigger state machine is not touched.
+    // data_chunk is expected to have window_size_samples samples.
+    float infer(const float* data_chunk) {
+        // The context is already at the front of input; append the current chunk.
+        std::copy(data_chunk, data_chunk + window_size_samples, input.begin() + context_samples);
+        return infer_in_place();
+    }
+
+    // Zero-copy input: the caller writes window_size() samples to
+    // window_input() and then calls infer_window(), or commit_window() to
+    // also advance the trigger state machine. This lets samples be decoded
+    // straight into the inference buffer; it must not be used while feed()
+    // holds a partial window.
+    float* window_input() { return input.data() + context_samples; }
+    float infer_window() { return infer_in_place(); }
+    void commit_window() {
+        audio_length_samples += window_size_samples;
+        segment_in_place();
+    }
+
+    int window_size() const { return window_size_samples; }
+
+    // Streaming input: feeds the next n samples of the recording, in blocks
+    // of any size. Whole windows are run as soon as they are complete; the
+    // remainder waits in the input buffer for the next call.
+    void feed(const float* samples, size_t n) {
+        audio_length_samples += static_cast<int64_t>(n);
+        while (n > 0) {
+            if (pending_samples == 0 && n >= static_cast<size_t>(window_size_samples)) {
+                predict(samples);
+                samples += window_size_samples;
+                n -= window_size_samples;
+                continue;
+            }
+            size_t take = std::min(n, static_cast<size_t>(window_size_samples - pending_samples));
+            std::copy(samples, samples + take, input.begin() + context_samples + pending_samples);
+            pending_samples += static_cast<int>(take);
+            samples += take;
+            n -= take;
+            if (pending_samples == window_size_samples) {
+                segment_in_place();
+                pending_samples = 0;
+            }
+        }
+    }
+
+    // Ends a fed recording: a trailing partial window is dropped, as in
+    // process(), and a segment still open runs to the end of the audio.
+    void finish() {
+        segmenter.finish(audio_length_samples);
+    }
+
+    // Process the entire audio input.
+    void process(const std::vector<float>& input_wav) {
+        reset_states();
+        feed(input_wav.data(), input_wav.size());
+        finish();
+    }
+
+    // Returns the detected speech timestamps.
+    const std::vector<timestamp_t> get_speech_timestamps() const {
+        return segmenter.get_speech_timestamps();
+    }
+
+    // Samples fed since the last reset.
+    int64_t audio_length() const { return audio_length_samples; }
+
+    // Appends the speech probability of every window that commit_window(),
+    // feed() and process() run to *log, until called with nullptr. The
+    // energy gate is bypassed meanwhile: which windows it skips depends on
+    // the trigger state, so a log with them as 0 could not be resegmented
+    // with other settings.
+    void log_probs(std::vector<float>* log) { prob_log = log; }
+
+    // Trigger state for live input: whether a segment is open, and where
+    // it started (-1 if none).
+    bool is_triggered() const { return segmenter.is_triggered(); }
+    int64_t get_current_start() const { return segmenter.get_current_start(); }
+
+    // Public method to reset the internal state.
+    void reset() {
+        reset_states();
+    }
+
+    // Energy pre-gate for commit_window(), feed() and process(): windows
+    // with an RMS below floor (samples in [-1, 1]) skip inference and count
+    // as non-speech. When inference resumes, up to warmup_windows of the
+    // skipped windows are run first to restore the state. floor <= 0 turns
+    // the gate off; infer() and infer_window() are never gated.
+    void set_energy_gate(float floor, int warmup_windows = 8) {
+        gate_floor = std::max(0.0f, floor);
+        gate_warmup = std::max(0, warmup_windows);
+        gate_history.assign(static_cast<size_t>(gate_warmup) * effective_window_size, 0.0f);
+        gate_saved.assign(effective_window_size, 0.0f);
+        gate_head = 0;
+        gate_run = 0;
+    }
+
+    // Gate counters since the last reset.
+    const gate_stats_t& gate_stats() const { return gate_counters; }
+
+public:
+    // Constructor: sets model path, sample rate, window size (ms), and other parameters.
+    // The parameters are set to match the Python version. Engine holds the
+    // ONNX Runtime threading settings (see auto_engine_config()).
+    VadIterator(const std::string& ModelPath,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 100,
+        int speech_pad_ms = 30, int min_speech_duration_ms = 250,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity(),
+        const EngineConfig& Engine = EngineConfig())
+        : sample_rate(Sample_rate),
+          segmenter(Sample_rate, windows_frame_size, Threshold, min_silence_duration_ms,
+                    speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        init_buffers(windows_frame_size);
+        init_onnx_model(ModelPath, Engine);
+        warm_up();
+    }
+
+    // Runs on an existing session (see create_vad_session()) instead of
+    // loading the model again. ORT sessions may be run from several threads
+    // at once, so iterators on different threads can share one.
+    VadIterator(std::shared_ptr<Ort::Session> Session,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 100,
+        int speech_pad_ms = 30, int min_speech_duration_ms = 250,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity())
+        : session(std::move(Session)),
+          sample_rate(Sample_rate),
+          segmenter(Sample_rate, windows_frame_size, Threshold, min_silence_duration_ms,
+                    speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        init_buffers(windows_frame_size);
+        warm_up();
+    }
+
+    // The tensors point into this object's buffers.
+    VadIterator(const VadIterator&) = delete;
+    VadIterator& operator=(const VadIterator&) = delete;
+};
+
+// VadBatchIterator class: steps N independent streams through one session.
+// Every call to predict() runs a single inference with input [N, 576] (at 16 kHz) and
+// state [2, N, 128]; each stream keeps its own context, trigger state machine
+// and timestamps. A stream without a chunk for the current step is left
+// untouched, so recordings of different lengths can share one batch.
+class VadBatchIterator {
+private:
+    // ONNX Runtime resources
+    Ort::SessionOptions session_options;
+    std::shared_ptr<Ort::Session> session = nullptr;
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+    Ort::RunOptions run_options{ nullptr };
+
+    int context_samples;            // per sample rate, see context_samples_for()
+    const int state_width = 128;
+
+    int num_streams;
+    int window_size_samples;
+    int effective_window_size;
+    int sample_rate;
+
+    // ONNX Runtime input/output buffers, bound once as in VadIterator. Each
+    // input row keeps its stream's context in place at the front, and the
+    // state is double buffered with cur selecting the tensor set.
+    std::vector<Ort::Value> ort_inputs[2];
+    std::vector<const char*> input_node_names = { "input", "state", "sr" };
+    std::vector<float> input;      // [N, effective_window_size]
+    std::vector<float> _state[2];  // [2, N, 128]
+    int cur = 0;
+    std::vector<int64_t> sr;
+    int64_t input_node_dims[2] = {};
+    int64_t state_node_dims[3] = {};
+    const int64_t sr_node_dims[1] = { 1 };
+    int64_t output_node_dims[2] = {};
+    std::vector<float> speech_probs;  // [N, 1]
+    std::vector<Ort::Value> ort_outputs[2];
+    std::vector<const char*> output_node_names = { "output", "stateN" };
+
+    // Per-stream trigger state machines
+    std::vector<VadSegmenter> segmenters;
+
+    // Per-stream probability logs (see log_probs()); null entries are off
+    std::vector<std::vector<float>*> prob_logs;
+
+    // Loads the ONNX model.
+    void init_onnx_model(const std::string& model_path, const EngineConfig& engine) {
+        session = create_vad_session(model_path, engine, session_options);
+    }
+
+    // Creates the input/output tensors over the persistent buffers.
+    void bind_tensors() {
+        for (int k = 0; k < 2; k++) {
+            ort_inputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, input.data(), input.size(), input_node_dims, 2));
+            ort_inputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, _state[k].data(), _state[k].size(), state_node_dims, 3));
+            ort_inputs[k].emplace_back(Ort::Value::CreateTensor<int64_t>(
+                memory_info, sr.data(), sr.size(), sr_node_dims, 1));
+            ort_outputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, speech_probs.data(), speech_probs.size(), output_node_dims, 2));
+            ort_outputs[k].emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, _state[k ^ 1].data(), _state[k ^ 1].size(), state_node_dims, 3));
+        }
+    }
+
+    // Copies stream i's state slices between the two state buffers.
+    void copy_stream_state(int i, const std::vector<float>& from, std::vector<float>& to) {
+        const size_t plane = static_cast<size_t>(num_streams) * state_width;
+        for (size_t k = 0; k < 2; k++) {
+            // state is [2, N, 128]: stream i owns one 128-wide slice in each plane.
+            const size_t off = k * plane + static_cast<size_t>(i) * state_width;
+            std::copy(from.begin() + off, from.begin() + off + state_width, to.begin() + off);
+        }
+    }
+
+public:
+    VadBatchIterator(const std::string& ModelPath, int NumStreams,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 100,
+        int speech_pad_ms = 30, int min_speech_duration_ms = 250,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity(),
+        const EngineConfig& Engine = EngineConfig())
+        : num_streams(NumStreams), sample_rate(Sample_rate)
+    {
+        if (num_streams < 1)
+            throw std::invalid_argument("VadBatchIterator needs at least one stream");
+        context_samples = context_samples_for(sample_rate);
+        window_size_samples = windows_frame_size * (sample_rate / 1000);
+        effective_window_size = window_size_samples + context_samples;
+        input_node_dims[0] = num_streams;
+        input_node_dims[1] = effective_window_size;
+        state_node_dims[0] = 2;
+        state_node_dims[1] = num_streams;
+        state_node_dims[2] = state_width;
+        output_node_dims[0] = num_streams;
+        output_node_dims[1] = 1;
+        input.assign(static_cast<size_t>(num_streams) * effective_window_size, 0.0f);
+        _state[0].assign(static_cast<size_t>(2) * num_streams * state_width, 0.0f);
+        _state[1].assign(static_cast<size_t>(2) * num_streams * state_width, 0.0f);
+        speech_probs.assign(num_streams, 0.0f);
+        sr.assign(1, sample_rate);
+        segmenters.assign(num_streams, VadSegmenter(Sample_rate, windows_frame_size, Threshold,
+            min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s));
+        prob_logs.assign(num_streams, nullptr);
+        init_onnx_model(ModelPath, Engine);
+        bind_tensors();
+
+        // Warm-up step on silence, so ORT's lazy initialisation is paid
+        // here rather than by the first real chunk.
+        std::vector<float> silence(window_size_samples, 0.0f);
+        std::vector<const float*> chunks(num_streams, silence.data());
+        predict(chunks.data());
+        reset();
+    }
+
+    // The tensors point into this object's buffers.
+    VadBatchIterator(const VadBatchIterator&) = delete;
+    VadBatchIterator& operator=(const VadBatchIterator&) = delete;
+
+    int streams() const { return num_streams; }
+    int window_size() const { return window_size_samples; }
+
+    // Runs one inference step for all streams. chunks[i] points to
+    // window_size_samples samples for stream i, or is nullptr when stream i
+    // has no audio for this step. Returns false if no stream was active.
+    bool predict(const float* const* chunks) {
+        bool any_active = false;
+        for (int i = 0; i < num_streams; i++) {
+            if (chunks[i] == nullptr)
+                continue;
+            any_active = true;
+            float* row = input.data() + static_cast<size_t>(i) * effective_window_size;
+            std::copy(chunks[i], chunks[i] + window_size_samples, row + context_samples);
+        }
+        if (!any_active)
+            return false;
+
+        {
+#ifdef __COUNT_ALLOCS___
+            alloc_stats::run_scope scope;
+#endif
+            session->Run(run_options,
+                input_node_names.data(), ort_inputs[cur].data(), ort_inputs[cur].size(),
+                output_node_names.data(), ort_outputs[cur].data(), ort_outputs[cur].size());
+        }
+        const int next = cur ^ 1;
+
+        for (int i = 0; i < num_streams; i++) {
+            if (chunks[i] == nullptr) {
+                // An idle stream's row was run on stale input; keep its old state.
+                copy_stream_state(i, _state[cur], _state[next]);
+                continue;
+            }
+            segmenters[i].push(speech_probs[i]);
+            if (prob_logs[i])
+                prob_logs[i]->push_back(speech_probs[i]);
+
+            float* row = input.data() + static_cast<size_t>(i) * effective_window_size;
+            std::copy(row + effective_window_size - context_samples, row + effective_window_size, row);
+        }
+        cur = next;
+        return true;
+    }
+
+    // Closes stream i after its last chunk; audio_length is the full length
+    // of the recording in samples, including a trailing partial window.
+    void finish(int i, int64_t audio_length) {
+        segmenters[i].finish(audio_length);
+    }
+
+    // Processes whole recordings, one per stream, in lockstep.
+    void process(const std::vector<std::vector<float>>& input_wavs) {
+        if (static_cast<int>(input_wavs.size()) > num_streams)
+            throw std::invalid_argument("more recordings than batch streams");
+        reset();
+        std::vector<const float*> chunks(num_streams, nullptr);
+        for (size_t j = 0;; j += static_cast<size_t>(window_size_samples)) {
+            for (int i = 0; i < num_streams; i++) {
+                chunks[i] = nullptr;
+                if (i < static_cast<int>(input_wavs.size()) &&
+                    j + static_cast<size_t>(window_size_samples) <= input_wavs[i].size())
+                    chunks[i] = input_wavs[i].data() + j;
+            }
+            if (!predict(chunks.data()))
+                break;
+        }
+        for (size_t i = 0; i < input_wavs.size(); i++)
+            finish(static_cast<int>(i), static_cast<int64_t>(input_wavs[i].size()));
+    }
+
+    // Appends stream i's per-window probabilities to *log, until called
+    // with nullptr.
+    void log_probs(int i, std::vector<float>* log) { prob_logs[i] = log; }
+
+    // Returns the detected speech timestamps of stream i.
+    const std::vector<timestamp_t>& get_speech_timestamps(int i) const {
+        return segmenters[i].get_speech_timestamps();
+    }
+
+    // Trigger state of stream i for live input: whether a segment is open.
+    bool is_triggered(int i) const { return segmenters[i].is_triggered(); }
+
+    // Speech probability of stream i's chunk in the last predict(); stale
+    // if stream i sat that step out.
+    float probability(int i) const { return speech_probs[i]; }
+
+    // Resets a single stream so it can take a new recording.
+    void reset_stream(int i) {
+        const size_t plane = static_cast<size_t>(num_streams) * state_width;
+        for (int b = 0; b < 2; b++)
+            for (size_t k = 0; k < 2; k++)
+                std::fill_n(_state[b].begin() + k * plane + static_cast<size_t>(i) * state_width, state_width, 0.0f);
+        std::fill_n(input.begin() + static_cast<size_t>(i) * effective_window_size, context_samples, 0.0f);
+        segmenters[i].reset();
+    }
+
+    // Resets every stream.
+    void reset() {
+        for (int i = 0; i < num_streams; i++)
+            reset_stream(i);
+    }
+};
+
+#endif  // VAD_ITERATOR_H_
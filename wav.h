@@ -17,15 +17,35 @@
 
 
 #include <assert.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <iostream>
 
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // #include "utils/log.h"
 
 namespace wav {
@@ -46,6 +66,142 @@ struct WavHeader {
   unsigned int data_size;
 };
 
+// PCM to float conversion kernels. The vector path is picked at compile
+// time from the target flags (-march=native in the MAKEFILE); the scalar
+// loop handles the tail and targets without SSE2.
+static inline void ConvertS16ToFloat(const int16_t* in, float* out, size_t n) {
+  const float scale = 1.0f / 32768;
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 vscale = _mm256_set1_ps(scale);
+  for (; i + 16 <= n; i += 16) {
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), vscale));
+    _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), vscale));
+  }
+#elif defined(__SSE2__)
+  const __m128 vscale = _mm_set1_ps(scale);
+  for (; i + 8 <= n; i += 8) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    // Sign-extend by placing each int16 in the high half and shifting down.
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = static_cast<float>(in[i]) * scale;
+}
+
+static inline void ConvertS32ToFloat(const int32_t* in, float* out, size_t n) {
+  const float scale = 1.0f / 2147483648.0f;
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 vscale = _mm256_set1_ps(scale);
+  for (; i + 8 <= n; i += 8) {
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s), vscale));
+  }
+#elif defined(__SSE2__)
+  const __m128 vscale = _mm_set1_ps(scale);
+  for (; i + 4 <= n; i += 4) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(s), vscale));
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = static_cast<float>(in[i]) * scale;
+}
+
+static inline void ConvertS8ToFloat(const int8_t* in, float* out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = static_cast<float>(in[i]) / 32768;
+}
+
+// Float to 16-bit PCM, the inverse of ConvertS16ToFloat: in[i] * scale
+// rounded to nearest and saturated to [-32768, 32767] (NaN gives -32768).
+// scale is 32768 for samples in [-1, 1], 1 for samples already at PCM scale.
+static inline void ConvertFloatToS16(const float* in, int16_t* out, size_t n,
+                                     float scale = 32768.0f) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256 vmin = _mm256_set1_ps(-32768.0f);
+  const __m256 vmax = _mm256_set1_ps(32767.0f);
+  for (; i + 16 <= n; i += 16) {
+    __m256 a = _mm256_mul_ps(_mm256_loadu_ps(in + i), vscale);
+    __m256 b = _mm256_mul_ps(_mm256_loadu_ps(in + i + 8), vscale);
+    a = _mm256_min_ps(_mm256_max_ps(a, vmin), vmax);
+    b = _mm256_min_ps(_mm256_max_ps(b, vmin), vmax);
+    // packs works per 128-bit lane; the permute puts a before b again.
+    __m256i s = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+    s = _mm256_permute4x64_epi64(s, 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), s);
+  }
+#elif defined(__SSE2__)
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 vmin = _mm_set1_ps(-32768.0f);
+  const __m128 vmax = _mm_set1_ps(32767.0f);
+  for (; i + 8 <= n; i += 8) {
+    __m128 a = _mm_mul_ps(_mm_loadu_ps(in + i), vscale);
+    __m128 b = _mm_mul_ps(_mm_loadu_ps(in + i + 4), vscale);
+    a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+    b = _mm_min_ps(_mm_max_ps(b, vmin), vmax);
+    __m128i s = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), s);
+  }
+#endif
+  for (; i < n; ++i) {
+    float v = in[i] * scale;
+    v = v > -32768.0f ? v : -32768.0f;
+    v = v < 32767.0f ? v : 32767.0f;
+    out[i] = static_cast<int16_t>(lrintf(v));
+  }
+}
+
+// Reads the RIFF header and positions fp at the first byte of the "data"
+// chunk. header->data_size is fixed up for streams that leave it at 0.
+static inline bool ReadWavHeader(FILE* fp, WavHeader* header) {
+  if (fread(header, 1, sizeof(*header), fp) != sizeof(*header)) {
+    fprintf(stderr, "WaveData: file is shorter than a WAV header.\n");
+    return false;
+  }
+  if (header->fmt_size < 16) {
+    fprintf(stderr, "WaveData: expect PCM format data "
+                    "to have fmt chunk of at least size 16.\n");
+    return false;
+  } else if (header->fmt_size > 16) {
+    int offset = 44 - 8 + header->fmt_size - 16;
+    fseek(fp, offset, SEEK_SET);
+    fread(header->data, 8, sizeof(char), fp);
+  }
+  // check "riff" "WAVE" "fmt " "data"
+
+  // Skip any sub-chunks between "fmt" and "data".  Usually there will
+  // be a single "fact" sub chunk, but on Windows there can also be a
+  // "list" sub chunk.
+  while (0 != strncmp(header->data, "data", 4)) {
+    // We will just ignore the data in these chunks.
+    fseek(fp, header->data_size, SEEK_CUR);
+    // read next sub chunk
+    if (fread(header->data, 8, sizeof(char), fp) != sizeof(char)) {
+      fprintf(stderr, "WaveData: no data chunk found.\n");
+      return false;
+    }
+  }
+
+  if (header->data_size == 0) {
+      int offset = ftell(fp);
+      fseek(fp, 0, SEEK_END);
+      header->data_size = ftell(fp) - offset;
+      fseek(fp, offset, SEEK_SET);
+  }
+  return true;
+}
+
 class WavReader {
  public:
   WavReader() : data_(nullptr) {}
@@ -54,38 +210,14 @@ class WavReader {
   bool Open(const std::string& filename) {
     FILE* fp = fopen(filename.c_str(), "rb"); //文件读取
     if (NULL == fp) {
-      std::cout << "Error in read " << filename;
+      std::cerr << "Error in read " << filename << std::endl;
       return false;
     }
 
     WavHeader header;
-    fread(&header, 1, sizeof(header), fp);
-    if (header.fmt_size < 16) {
-      printf("WaveData: expect PCM format data "
-              "to have fmt chunk of at least size 16.\n");
+    if (!ReadWavHeader(fp, &header)) {
+      fclose(fp);
       return false;
-    } else if (header.fmt_size > 16) {
-      int offset = 44 - 8 + header.fmt_size - 16;
-      fseek(fp, offset, SEEK_SET);
-      fread(header.data, 8, sizeof(char), fp);
-    }
-    // check "riff" "WAVE" "fmt " "data"
-
-    // Skip any sub-chunks between "fmt" and "data".  Usually there will
-    // be a single "fact" sub chunk, but on Windows there can also be a
-    // "list" sub chunk.
-    while (0 != strncmp(header.data, "data", 4)) {
-      // We will just ignore the data in these chunks.
-      fseek(fp, header.data_size, SEEK_CUR);
-      // read next sub chunk
-      fread(header.data, 8, sizeof(char), fp);
-    }
-
-    if (header.data_size == 0) {
-        int offset = ftell(fp);
-        fseek(fp, 0, SEEK_END);
-        header.data_size = ftell(fp) - offset;
-        fseek(fp, offset, SEEK_SET);
     }
 
     num_channel_ = header.channels;
@@ -95,11 +227,11 @@ class WavReader {
     data_ = new float[num_data]; // Create 1-dim array
     num_samples_ = num_data / num_channel_;
 
-    std::cout << "num_channel_    :" << num_channel_ << std::endl;
-    std::cout << "sample_rate_    :" << sample_rate_ << std::endl;
-    std::cout << "bits_per_sample_:" << bits_per_sample_ << std::endl;
-    std::cout << "num_samples     :" << num_data << std::endl;
-    std::cout << "num_data_size   :" << header.data_size << std::endl;
+    std::cerr << "num_channel_    :" << num_channel_ << std::endl;
+    std::cerr << "sample_rate_    :" << sample_rate_ << std::endl;
+    std::cerr << "bits_per_sample_:" << bits_per_sample_ << std::endl;
+    std::cerr << "num_samples     :" << num_data << std::endl;
+    std::cerr << "num_data_size   :" << header.data_size << std::endl;
 
     switch (bits_per_sample_) {
         case 8: {
@@ -125,7 +257,7 @@ class WavReader {
                 int sample;
                 for (int i = 0; i < num_data; ++i) {
                     fread(&sample, 1, sizeof(int), fp);
-                    data_[i] = static_cast<float>(sample) / 32768;
+                    data_[i] = static_cast<float>(sample) / 2147483648.0f;
                 }
             }
             else if (header.format == 3) // IEEE-float
@@ -137,12 +269,12 @@ class WavReader {
                 }
             }
             else {
-                printf("unsupported quantization bits\n");
+                fprintf(stderr, "unsupported quantization bits\n");
             }
             break;
         }
         default:
-            printf("unsupported quantization bits\n");
+            fprintf(stderr, "unsupported quantization bits\n");
             break;
     }
 
@@ -162,11 +294,393 @@ class WavReader {
   const float* data() const { return data_; }
 
  private:
-  int num_channel_;
-  int sample_rate_;
-  int bits_per_sample_;
-  int num_samples_;  // sample points per channel
-  float* data_;
+  int num_channel_ = 0;
+  int sample_rate_ = 0;
+  int bits_per_sample_ = 0;
+  int num_samples_ = 0;  // sample points per channel
+  float* data_ = nullptr;
+};
+
+// Streaming counterpart of WavReader: parses the header on Open() and then
+// decodes the data chunk block by block on Read(), so memory use does not
+// depend on the file length. Samples are converted exactly as WavReader
+// converts them and are returned interleaved.
+class WavStreamReader {
+ public:
+  WavStreamReader() {}
+  explicit WavStreamReader(const std::string& filename) { Open(filename); }
+
+  bool Open(const std::string& filename) {
+    Close();
+    fp_ = fopen(filename.c_str(), "rb");
+    if (NULL == fp_) {
+      std::cerr << "Error in read " << filename << std::endl;
+      return false;
+    }
+    WavHeader header;
+    if (!ReadWavHeader(fp_, &header)) {
+      Close();
+      return false;
+    }
+    num_channel_ = header.channels;
+    sample_rate_ = header.sample_rate;
+    bits_per_sample_ = header.bit;
+    format_ = header.format;
+    if (num_channel_ == 0 ||
+        !(bits_per_sample_ == 8 || bits_per_sample_ == 16 ||
+          (bits_per_sample_ == 32 && (format_ == 1 || format_ == 3)))) {
+      fprintf(stderr, "unsupported quantization bits\n");
+      Close();
+      return false;
+    }
+    remaining_ = header.data_size / (bits_per_sample_ / 8);
+    num_samples_ = remaining_ / num_channel_;
+    return true;
+  }
+
+  // Decodes up to max_samples interleaved samples into out and returns how
+  // many were decoded; 0 at the end of the data chunk.
+  size_t Read(float* out, size_t max_samples) {
+    if (fp_ == NULL)
+      return 0;
+    const size_t bytes = bits_per_sample_ / 8;
+    size_t want = max_samples < remaining_ ? max_samples : remaining_;
+    if (raw_.size() < want * bytes)
+      raw_.resize(want * bytes);
+    size_t got = fread(raw_.data(), bytes, want, fp_);
+    remaining_ -= got;
+    if (got < want)
+      remaining_ = 0;  // truncated file
+
+    const char* raw = raw_.data();
+    switch (bits_per_sample_) {
+      case 8:
+        ConvertS8ToFloat(reinterpret_cast<const int8_t*>(raw), out, got);
+        break;
+      case 16:
+        ConvertS16ToFloat(reinterpret_cast<const int16_t*>(raw), out, got);
+        break;
+      case 32:
+        if (format_ == 1)  // S32
+          ConvertS32ToFloat(reinterpret_cast<const int32_t*>(raw), out, got);
+        else  // IEEE-float
+          memcpy(out, raw, got * sizeof(float));
+        break;
+    }
+    return got;
+  }
+
+  void Close() {
+    if (fp_ != NULL)
+      fclose(fp_);
+    fp_ = NULL;
+    remaining_ = 0;
+  }
+
+  ~WavStreamReader() { Close(); }
+
+  WavStreamReader(const WavStreamReader&) = delete;
+  WavStreamReader& operator=(const WavStreamReader&) = delete;
+
+  bool is_open() const { return fp_ != NULL; }
+  int num_channel() const { return num_channel_; }
+  int sample_rate() const { return sample_rate_; }
+  int bits_per_sample() const { return bits_per_sample_; }
+  int num_samples() const { return num_samples_; }
+
+ private:
+  FILE* fp_ = NULL;
+  int num_channel_ = 0;
+  int sample_rate_ = 0;
+  int bits_per_sample_ = 0;
+  int format_ = 0;
+  int num_samples_ = 0;  // sample points per channel
+  size_t remaining_ = 0;  // interleaved samples left in the data chunk
+  std::vector<char> raw_;
+};
+
+// Memory-mapped WAV access. Open() maps the file and parses the header;
+// Convert() then decodes any range of samples straight into a caller
+// buffer, such as the inference input of a VadIterator, so the recording
+// is never held as floats and only the pages touched are read. Where
+// mmap is not available the data chunk is read into memory once instead.
+class WavMmapReader {
+ public:
+  WavMmapReader() {}
+  explicit WavMmapReader(const std::string& filename) { Open(filename); }
+
+  bool Open(const std::string& filename) {
+    Close();
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (NULL == fp) {
+      std::cerr << "Error in read " << filename << std::endl;
+      return false;
+    }
+    WavHeader header;
+    if (!ReadWavHeader(fp, &header)) {
+      fclose(fp);
+      return false;
+    }
+    long data_offset = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+
+    num_channel_ = header.channels;
+    sample_rate_ = header.sample_rate;
+    bits_per_sample_ = header.bit;
+    format_ = header.format;
+    if (num_channel_ == 0 ||
+        !(bits_per_sample_ == 8 || bits_per_sample_ == 16 ||
+          (bits_per_sample_ == 32 && (format_ == 1 || format_ == 3)))) {
+      fprintf(stderr, "unsupported quantization bits\n");
+      fclose(fp);
+      return false;
+    }
+    size_t data_bytes = header.data_size;
+    if (data_offset + static_cast<long>(data_bytes) > file_size)
+      data_bytes = file_size - data_offset;  // truncated file
+
+#if defined(_WIN32)
+    buffer_.resize(data_bytes);
+    fseek(fp, data_offset, SEEK_SET);
+    data_bytes = fread(buffer_.data(), 1, data_bytes, fp);
+    data_ = buffer_.data();
+#else
+    if (data_bytes > 0) {
+      map_size_ = static_cast<size_t>(data_offset) + data_bytes;
+      void* map = mmap(NULL, map_size_, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+      if (map == MAP_FAILED) {
+        map_size_ = 0;
+        fclose(fp);
+        return false;
+      }
+      madvise(map, map_size_, MADV_SEQUENTIAL);
+      map_ = static_cast<char*>(map);
+      data_ = map_ + data_offset;
+    }
+#endif
+    fclose(fp);
+    num_data_ = data_bytes / (bits_per_sample_ / 8);
+    num_samples_ = num_data_ / num_channel_;
+    return true;
+  }
+
+  // Converts interleaved samples [first, first + count) to float.
+  void Convert(size_t first, size_t count, float* out) const {
+    const char* raw = data_ + first * (bits_per_sample_ / 8);
+    switch (bits_per_sample_) {
+      case 8:
+        ConvertS8ToFloat(reinterpret_cast<const int8_t*>(raw), out, count);
+        break;
+      case 16:
+        ConvertS16ToFloat(reinterpret_cast<const int16_t*>(raw), out, count);
+        break;
+      case 32:
+        if (format_ == 1)  // S32
+          ConvertS32ToFloat(reinterpret_cast<const int32_t*>(raw), out, count);
+        else  // IEEE-float
+          memcpy(out, raw, count * sizeof(float));
+        break;
+    }
+  }
+
+  void Close() {
+#if !defined(_WIN32)
+    if (map_ != NULL)
+      munmap(map_, map_size_);
+#endif
+    map_ = NULL;
+    map_size_ = 0;
+    data_ = NULL;
+    num_data_ = 0;
+    num_samples_ = 0;
+    buffer_.clear();
+  }
+
+  ~WavMmapReader() { Close(); }
+
+  WavMmapReader(const WavMmapReader&) = delete;
+  WavMmapReader& operator=(const WavMmapReader&) = delete;
+
+  int num_channel() const { return num_channel_; }
+  int sample_rate() const { return sample_rate_; }
+  int bits_per_sample() const { return bits_per_sample_; }
+  int format() const { return format_; }
+  int num_samples() const { return num_samples_; }
+  // Interleaved samples in the data chunk (num_samples() * num_channel()).
+  size_t num_data() const { return num_data_; }
+  // Raw bytes of the data chunk.
+  const char* raw_data() const { return data_; }
+
+ private:
+  char* map_ = NULL;
+  size_t map_size_ = 0;
+  std::vector<char> buffer_;
+  const char* data_ = NULL;
+  int num_channel_ = 0;
+  int sample_rate_ = 0;
+  int bits_per_sample_ = 0;
+  int format_ = 0;
+  int num_samples_ = 0;  // sample points per channel
+  size_t num_data_ = 0;
+};
+
+// Writes a 16-bit PCM WAV file incrementally: Open() writes a header that
+// Close() fills in once the length is known. Float input is converted into
+// an internal block (kBlockSamples) and written with one fwrite per block;
+// PCM input larger than a block is written straight from the caller's
+// buffer. AddCue() marks positions (in frames) that Close() stores in a
+// "cue " chunk after the data, so one file can hold several segments.
+class WavFileWriter {
+ public:
+  static const size_t kBlockSamples = 32768;
+
+  WavFileWriter() {}
+  ~WavFileWriter() { Close(); }
+
+  bool Open(const std::string& filename, int sample_rate, int num_channel) {
+    Close();
+    fp_ = fopen(filename.c_str(), "wb");
+    if (fp_ == NULL)
+      return false;
+    setvbuf(fp_, NULL, _IONBF, 0);  // blocks are buffered here
+    num_channel_ = num_channel;
+    sample_rate_ = sample_rate;
+    data_bytes_ = 0;
+    buffered_ = 0;
+    cues_.clear();
+    ok_ = true;
+    WavHeader header = Header();
+    ok_ = fwrite(&header, 1, sizeof(header), fp_) == sizeof(header);
+    buffer_.resize(kBlockSamples);
+    return ok_;
+  }
+
+  bool is_open() const { return fp_ != NULL; }
+
+  // Appends n interleaved samples in [-1, 1].
+  bool WriteFloat(const float* data, size_t n) {
+    while (n > 0 && ok_) {
+      size_t take = std::min(n, kBlockSamples - buffered_);
+      ConvertFloatToS16(data, buffer_.data() + buffered_, take);
+      buffered_ += take;
+      data += take;
+      n -= take;
+      if (buffered_ == kBlockSamples)
+        Flush();
+    }
+    return ok_;
+  }
+
+  // Appends n interleaved 16-bit samples.
+  bool WriteS16(const int16_t* data, size_t n) {
+    if (buffered_ + n <= kBlockSamples) {
+      memcpy(buffer_.data() + buffered_, data, n * sizeof(int16_t));
+      buffered_ += n;
+      return ok_;
+    }
+    Flush();
+    if (ok_)
+      ok_ = fwrite(data, sizeof(int16_t), n, fp_) == n;
+    data_bytes_ += n * sizeof(int16_t);
+    return ok_;
+  }
+
+  // Marks the current end of the data as a cue point.
+  void AddCue() {
+    cues_.push_back(static_cast<uint32_t>(
+        (data_bytes_ + buffered_ * sizeof(int16_t)) / (num_channel_ * sizeof(int16_t))));
+  }
+
+  // Frames written so far.
+  size_t num_frames() const {
+    return (data_bytes_ + buffered_ * sizeof(int16_t)) / (num_channel_ * sizeof(int16_t));
+  }
+
+  // Writes out the data so far and a header that covers it, so the file
+  // is complete up to here should the process end without Close() (the
+  // cue chunk is only written by Close()).
+  bool Sync() {
+    if (fp_ == NULL)
+      return false;
+    Flush();
+    WavHeader header = Header();
+    ok_ = ok_ && fseek(fp_, 0, SEEK_SET) == 0 &&
+          fwrite(&header, 1, sizeof(header), fp_) == sizeof(header) &&
+          fseek(fp_, 0, SEEK_END) == 0 && fflush(fp_) == 0;
+    return ok_;
+  }
+
+  // Flushes, completes the header and closes; false if any write failed.
+  bool Close() {
+    if (fp_ == NULL)
+      return ok_;
+    Flush();
+    uint32_t riff_size = static_cast<uint32_t>(sizeof(WavHeader) - 8 + data_bytes_);
+    if (!cues_.empty() && ok_) {
+      uint32_t cue_header[3] = {0, static_cast<uint32_t>(4 + 24 * cues_.size()),
+                                static_cast<uint32_t>(cues_.size())};
+      memcpy(&cue_header[0], "cue ", 4);
+      std::vector<uint32_t> points(6 * cues_.size());
+      for (size_t k = 0; k < cues_.size(); ++k) {
+        uint32_t* p = &points[6 * k];
+        p[0] = static_cast<uint32_t>(k + 1);  // id
+        p[1] = cues_[k];                      // play order position
+        memcpy(&p[2], "data", 4);             // chunk holding the sample
+        p[3] = 0;                             // chunk start
+        p[4] = 0;                             // block start
+        p[5] = cues_[k];                      // sample offset
+      }
+      ok_ = fwrite(cue_header, 4, 3, fp_) == 3 &&
+            fwrite(points.data(), 4, points.size(), fp_) == points.size();
+      riff_size += 12 + 24 * static_cast<uint32_t>(cues_.size());
+    }
+    WavHeader header = Header();
+    header.size = riff_size;
+    ok_ = ok_ && fseek(fp_, 0, SEEK_SET) == 0 &&
+          fwrite(&header, 1, sizeof(header), fp_) == sizeof(header);
+    ok_ = fclose(fp_) == 0 && ok_;
+    fp_ = NULL;
+    return ok_;
+  }
+
+ private:
+  WavHeader Header() const {
+    WavHeader header;
+    memcpy(header.riff, "RIFF", 4);
+    memcpy(header.wav, "WAVE", 4);
+    memcpy(header.fmt, "fmt ", 4);
+    memcpy(header.data, "data", 4);
+    header.fmt_size = 16;
+    header.format = 1;
+    header.channels = static_cast<uint16_t>(num_channel_);
+    header.sample_rate = sample_rate_;
+    header.block_size = static_cast<uint16_t>(num_channel_ * sizeof(int16_t));
+    header.bytes_per_second = sample_rate_ * header.block_size;
+    header.bit = 16;
+    header.data_size = static_cast<unsigned int>(data_bytes_);
+    header.size = static_cast<unsigned int>(sizeof(header) - 8 + data_bytes_);
+    return header;
+  }
+
+  void Flush() {
+    if (buffered_ > 0 && ok_)
+      ok_ = fwrite(buffer_.data(), sizeof(int16_t), buffered_, fp_) == buffered_;
+    data_bytes_ += buffered_ * sizeof(int16_t);
+    buffered_ = 0;
+  }
+
+  WavFileWriter(const WavFileWriter&) = delete;
+  WavFileWriter& operator=(const WavFileWriter&) = delete;
+
+  FILE* fp_ = NULL;
+  int num_channel_ = 1;
+  int sample_rate_ = 16000;
+  uint64_t data_bytes_ = 0;
+  std::vector<int16_t> buffer_;
+  size_t buffered_ = 0;
+  std::vector<uint32_t> cues_;
+  bool ok_ = true;
 };
 
 class WavWriter {
@@ -179,16 +693,21 @@ class WavWriter {
         sample_rate_(sample_rate),
         bits_per_sample_(bits_per_sample) {}
 
+  // data_ holds samples at PCM scale (e.g. [-32768, 32767] for 16 bits).
+  // They are converted a block at a time and written with one fwrite per
+  // block; 16 bits go through the vector kernel and are rounded and
+  // saturated, 8 and 32 bits are truncated as before.
   void Write(const std::string& filename) {
-    FILE* fp = fopen(filename.c_str(), "w");
-    // init char 'riff' 'WAVE' 'fmt ' 'data'
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == NULL)
+      return;
     WavHeader header;
-    char wav_header[44] = {0x52, 0x49, 0x46, 0x46, 0x00, 0x00, 0x00, 0x00, 0x57,
-                           0x41, 0x56, 0x45, 0x66, 0x6d, 0x74, 0x20, 0x10, 0x00,
-                           0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                           0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                           0x64, 0x61, 0x74, 0x61, 0x00, 0x00, 0x00, 0x00};
-    memcpy(&header, wav_header, sizeof(header));
+    memcpy(header.riff, "RIFF", 4);
+    memcpy(header.wav, "WAVE", 4);
+    memcpy(header.fmt, "fmt ", 4);
+    memcpy(header.data, "data", 4);
+    header.fmt_size = 16;
+    header.format = 1;
     header.channels = num_channel_;
     header.bit = bits_per_sample_;
     header.sample_rate = sample_rate_;
@@ -200,25 +719,29 @@ class WavWriter {
 
     fwrite(&header, 1, sizeof(header), fp);
 
-    for (int i = 0; i < num_samples_; ++i) {
-      for (int j = 0; j < num_channel_; ++j) {
-        switch (bits_per_sample_) {
-          case 8: {
-            char sample = static_cast<char>(data_[i * num_channel_ + j]);
-            fwrite(&sample, 1, sizeof(sample), fp);
-            break;
-          }
-          case 16: {
-            int16_t sample = static_cast<int16_t>(data_[i * num_channel_ + j]);
-            fwrite(&sample, 1, sizeof(sample), fp);
-            break;
-          }
-          case 32: {
-            int sample = static_cast<int>(data_[i * num_channel_ + j]);
-            fwrite(&sample, 1, sizeof(sample), fp);
-            break;
+    const size_t total = static_cast<size_t>(num_samples_) * num_channel_;
+    const size_t block = 8192;
+    std::vector<char> out(block * sizeof(int32_t));
+    for (size_t i = 0; i < total; i += block) {
+      const size_t n = std::min(block, total - i);
+      const float* in = data_ + i;
+      switch (bits_per_sample_) {
+        case 8:
+          for (size_t k = 0; k < n; ++k)
+            out[k] = static_cast<char>(in[k]);
+          fwrite(out.data(), 1, n, fp);
+          break;
+        case 16:
+          ConvertFloatToS16(in, reinterpret_cast<int16_t*>(out.data()), n, 1.0f);
+          fwrite(out.data(), sizeof(int16_t), n, fp);
+          break;
+        case 32:
+          for (size_t k = 0; k < n; ++k) {
+            int sample = static_cast<int>(in[k]);
+            memcpy(out.data() + k * sizeof(int), &sample, sizeof(int));
           }
-        }
+          fwrite(out.data(), sizeof(int), n, fp);
+          break;
       }
     }
     fclose(fp);